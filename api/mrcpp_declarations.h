@@ -44,6 +44,7 @@ template <int D> class BoundingBox;
 template <int D> class NodeBox;
 template <int D> class NodeIndex;
 template <int D> class NodeIndexComp;
+template <int D> class NodeHashTable;
 
 class SharedMemory;
 class ScalingBasis;
@@ -87,6 +88,7 @@ template <int D> class DefaultCalculator;
 template <int D> class ProjectionCalculator;
 template <int D> class AdditionCalculator;
 template <int D> class MultiplicationCalculator;
+template <int D> class SumOfProductsCalculator;
 template <int D> class ConvolutionCalculator;
 template <int D> class DerivativeCalculator;
 class CrossCorrelationCalculator;
@@ -1,4 +1,5 @@
 #include <tuple>
+#include <vector>
 
 #include "MRCPP/MWFunctions"
 #include "MRCPP/Parallel"
@@ -61,23 +62,30 @@ int main(int argc, char **argv) {
         f_vec.push_back(std::make_tuple(1.0, tree));
     }
 
-    Eigen::MatrixXd S = Eigen::MatrixXd::Zero(nFuncs, nFuncs);
-    for (int j = 0; j < f_vec.size(); j++) {
-        int dst = j % wsize;
-        mrcpp::FunctionTree<3> &f_j = get_func(f_vec, j);
-        for (int i = 0; i < f_vec.size(); i++) {
-            int src = i % wsize;
-            mrcpp::FunctionTree<3> &f_i = get_func(f_vec, i);
-            if (src != dst) {
-                int tag = 1000000 * dst;
-                if (wrank == src) mrcpp::send_tree(f_i, dst, tag, comm);
-                if (wrank == dst) mrcpp::recv_tree(f_i, src, tag, comm);
-            }
-            // Compute my column(s) of the overlap matrix
-            if (wrank == dst) S(i, j) = mrcpp::dot(f_i, f_j);
+    // Send all functions to all ranks
+    for (int i = 0; i < f_vec.size(); i++) {
+        int src = i % wsize;
+        mrcpp::FunctionTree<3> &f_i = get_func(f_vec, i);
+        for (int dst = 0; dst < wsize; dst++) {
+            if (src == dst) continue;
+            int tag = 1000000 * dst;
+            if (wrank == src) mrcpp::send_tree(f_i, dst, tag, comm);
+            if (wrank == dst) mrcpp::recv_tree(f_i, src, tag, comm);
         }
     }
 
+    // Compute my column(s) of the overlap matrix in one pass over the grids
+    mrcpp::FunctionTreeVector<3> my_vec;
+    std::vector<int> my_cols;
+    for (int j = 0; j < f_vec.size(); j++) {
+        if (j % wsize != wrank) continue;
+        my_vec.push_back(f_vec[j]);
+        my_cols.push_back(j);
+    }
+    Eigen::MatrixXd S = Eigen::MatrixXd::Zero(nFuncs, nFuncs);
+    Eigen::MatrixXd S_loc = mrcpp::calc_overlap_matrix(f_vec, my_vec);
+    for (int j = 0; j < my_cols.size(); j++) S.col(my_cols[j]) = S_loc.col(j);
+
     // Delete all trees
     clear(f_vec, true);
 
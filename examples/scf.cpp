@@ -63,6 +63,16 @@ int main(int argc, char **argv) {
     Printer::init(printlevel);
     print::environment(0);
 
+    // Recycle the memory of the temporary trees created in each iteration
+    ChunkPool::setEnabled(true);
+
+    // Share the Helmholtz operator terms between the SCF cycles. Exponents
+    // are matched within a relative tolerance comparable to the kernel
+    // precision, so the trees are reused as mu converges
+    getOperatorCache(oper_cache);
+    oper_cache.setEnabled(true);
+    oper_cache.setTolerance(prec / 10.0);
+
     // Constructing world box
     auto min_scale = -4;
     auto corner = std::array<int, D>{-1, -1, -1};
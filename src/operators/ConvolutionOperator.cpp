@@ -25,9 +25,11 @@
 
 #include "ConvolutionOperator.h"
 #include "GreensKernel.h"
-#include "functions/Gaussian.h"
+#include "OperatorCache.h"
+#include "functions/GaussFunc.h"
 #include "treebuilders/CrossCorrelationCalculator.h"
 #include "treebuilders/OperatorAdaptor.h"
+#include "treebuilders/RescaleCalculator.h"
 #include "treebuilders/TreeBuilder.h"
 #include "treebuilders/grid.h"
 #include "treebuilders/project.h"
@@ -52,16 +54,49 @@ ConvolutionOperator<D>::ConvolutionOperator(const MultiResolutionAnalysis<D> &mr
 
 template <int D> ConvolutionOperator<D>::~ConvolutionOperator() {
     this->clearKernel();
+    this->clearShared();
 }
 
+/** Expand each term of the kernel into an OperatorTree. With the OperatorCache
+ * enabled, Gaussian terms are first looked up in the cache: a tree with the
+ * same coefficient is shared, a tree with a different coefficient is copied
+ * and rescaled, which is much cheaper than the cross-correlation. Trees that
+ * are built from scratch are added to the cache. Operators sharing a tree
+ * must not be applied concurrently, see OperatorCache. */
 template <int D> void ConvolutionOperator<D>::initializeOperator(GreensKernel &greens_kernel) {
     int max_scale = this->oper_mra.getMaxScale();
 
     TreeBuilder<2> builder;
     OperatorAdaptor adaptor(this->prec, max_scale);
+    getOperatorCache(cache);
 
     for (int i = 0; i < greens_kernel.size(); i++) {
         Gaussian<1> &k_func = *greens_kernel[i];
+        bool cacheable = cache.isEnabled() and (dynamic_cast<GaussFunc<1> *>(&k_func) != nullptr);
+        cacheable = cacheable and (k_func.getPos()[0] == 0.0);
+
+        double k_exp = k_func.getExp()[0];
+        double k_coef = k_func.getCoef();
+        if (cacheable) {
+            double c_coef = k_coef;
+            auto c_tree = cache.get(this->oper_mra, this->kern_mra, this->prec, k_exp, c_coef);
+            if (c_tree != nullptr and c_coef == k_coef) {
+                this->shared_exp.push_back(c_tree);
+                this->oper_exp.push_back(c_tree.get());
+                continue;
+            }
+            if (c_tree != nullptr and c_coef != 0.0) {
+                RescaleCalculator<2> calculator(k_coef / c_coef, *c_tree);
+                auto *o_tree = new OperatorTree(this->oper_mra, this->prec);
+                builder.build(*o_tree, calculator, adaptor, -1); // Copy the grid of the cached tree
+                o_tree->mwTransform(BottomUp);
+                o_tree->calcSquareNorm();
+                o_tree->setupOperNodeCache();
+                this->oper_exp.push_back(o_tree);
+                continue;
+            }
+        }
+
         auto *k_tree = new FunctionTree<1>(this->kern_mra);
         mrcpp::build_grid(*k_tree, k_func);               // Generate empty grid to hold narrow Gaussian
         mrcpp::project(this->prec / 10, *k_tree, k_func); // Project Gaussian starting from the empty grid
@@ -78,6 +113,11 @@ template <int D> void ConvolutionOperator<D>::initializeOperator(GreensKernel &g
         print::separator(10, ' ');
 
         this->kern_exp.push_back(std::make_tuple(1.0, k_tree));
+        if (cacheable) {
+            std::shared_ptr<OperatorTree> c_tree(o_tree);
+            cache.load(this->oper_mra, this->kern_mra, this->prec, k_exp, k_coef, c_tree);
+            this->shared_exp.push_back(c_tree);
+        }
         this->oper_exp.push_back(o_tree);
     }
 }
@@ -87,6 +127,24 @@ template <int D> void ConvolutionOperator<D>::clearKernel() {
     mrcpp::clear(this->kern_exp, true);
 }
 
+/** Remove all components. Components owned by the OperatorCache are
+ * detached first, they are never deleted here. */
+template <int D> void ConvolutionOperator<D>::clear(bool dealloc) {
+    this->clearShared();
+    MWOperator::clear(dealloc);
+}
+
+/** Detach the components owned by the OperatorCache, so that they are
+ * released by their shared pointers rather than deleted by MWOperator */
+template <int D> void ConvolutionOperator<D>::clearShared() {
+    for (auto &o_tree : this->oper_exp) {
+        for (auto &s_tree : this->shared_exp) {
+            if (o_tree == s_tree.get()) o_tree = nullptr;
+        }
+    }
+    this->shared_exp.clear();
+}
+
 template <int D>
 double ConvolutionOperator<D>::calcMinDistance(const MultiResolutionAnalysis<D> &MRA, double epsilon) const {
     int maxScale = MRA.getMaxScale();
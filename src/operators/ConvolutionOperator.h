@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include "MWOperator.h"
 #include "trees/FunctionTreeVector.h"
 
@@ -37,13 +39,17 @@ public:
     ConvolutionOperator &operator=(const ConvolutionOperator &oper) = delete;
     ~ConvolutionOperator() override;
 
+    void clear(bool dealloc = false) override;
+
 protected:
     MultiResolutionAnalysis<1> kern_mra;
     FunctionTreeVector<1> kern_exp;
+    std::vector<std::shared_ptr<OperatorTree>> shared_exp; ///< Components owned by the OperatorCache
     double prec;
 
     void initializeOperator(GreensKernel &greens_kernel);
     void clearKernel();
+    void clearShared();
 
     double calcMinDistance(const MultiResolutionAnalysis<D> &MRA, double epsilon) const;
     double calcMaxDistance(const MultiResolutionAnalysis<D> &MRA) const;
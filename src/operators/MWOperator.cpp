@@ -23,8 +23,12 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <fstream>
+#include <sstream>
+
 #include "MWOperator.h"
 #include "trees/BandWidth.h"
+#include "trees/OperatorNode.h"
 #include "utils/Printer.h"
 #include "utils/Timer.h"
 
@@ -93,4 +97,161 @@ void MWOperator::calcBandWidths(double prec) {
     println(20, "  Maximum bandwidths:\n" << this->band_max << std::endl);
 }
 
+const std::vector<OperatorTerm> &MWOperator::getReducedTerms(int depth) const {
+    if (depth < 0 or depth >= this->term_lists.size()) MSG_ABORT("Out of bounds");
+    return this->term_lists[depth];
+}
+
+/** @brief Compress the operator expansion separately at each depth
+ *
+ * @param[in] prec: Relative precision of the reduced expansion
+ * @param[in] dim: Dimension of the space the operator is applied in
+ *
+ * @details The terms are dropped or merged based on their operator blocks
+ * within the bandwidth, so calcBandWidths must be called first. The norm of a
+ * term at a given depth is bounded by the sum of its block norms to the power
+ * dim. Each term may introduce an error of prec/10 of the total bound, shared
+ * evenly among the terms. A term is dropped if its bound is below this limit.
+ * It is merged into the previous kept term if both have the same bandwidth
+ * and its blocks are proportional to the kept ones, up to a relative
+ * difference delta such that dim * delta times its bound is below the limit.
+ * This typically happens for the narrow kernel terms at coarse scales. A
+ * merged term adds c^dim to the coefficient of the kept term, where c is the
+ * proportionality constant.
+ */
+void MWOperator::calcReducedTerms(double prec, int dim) {
+    this->term_lists.clear();
+    int nTerms = size();
+    double termPrec = prec / (10.0 * nTerms);
+
+    for (int depth = 0; depth < this->band_max.size(); depth++) {
+        // Upper bound of the norm of each term at this depth
+        std::vector<double> bounds(nTerms, 0.0);
+        double totBound = 0.0;
+        for (int i = 0; i < nTerms; i++) {
+            const OperatorTree &oTree = getComponent(i);
+            int width = oTree.getBandWidth().getMaxWidth(depth);
+            if (width < 0) continue;
+            double sum = 0.0;
+            for (int l = -width; l <= width; l++) sum += std::sqrt(oTree.getNode(depth, l).getSquareNorm());
+            bounds[i] = std::pow(sum, dim);
+            totBound += bounds[i];
+        }
+
+        std::vector<OperatorTerm> terms;
+        int nMerged = 0;
+        for (int i = 0; i < nTerms; i++) {
+            double maxError = termPrec * totBound;
+            if (bounds[i] <= maxError) continue;
+            if (not terms.empty()) {
+                const OperatorTree &iTree = getComponent(i);
+                const OperatorTree &rTree = getComponent(terms.back().comp);
+                int width = iTree.getBandWidth().getMaxWidth(depth);
+                if (width == rTree.getBandWidth().getMaxWidth(depth)) {
+                    double ii = 0.0, ir = 0.0, rr = 0.0;
+                    for (int l = -width; l <= width; l++) {
+                        const OperatorNode &iNode = iTree.getNode(depth, l);
+                        const OperatorNode &rNode = rTree.getNode(depth, l);
+                        Eigen::Map<const VectorXd> iCoefs(iNode.getCoefs(), iNode.getNCoefs());
+                        Eigen::Map<const VectorXd> rCoefs(rNode.getCoefs(), rNode.getNCoefs());
+                        ii += iCoefs.squaredNorm();
+                        ir += iCoefs.dot(rCoefs);
+                        rr += rCoefs.squaredNorm();
+                    }
+                    double c = (rr > 0.0) ? ir / rr : 0.0;
+                    double diff = 0.0;
+                    for (int l = -width; l <= width; l++) {
+                        const OperatorNode &iNode = iTree.getNode(depth, l);
+                        const OperatorNode &rNode = rTree.getNode(depth, l);
+                        Eigen::Map<const VectorXd> iCoefs(iNode.getCoefs(), iNode.getNCoefs());
+                        Eigen::Map<const VectorXd> rCoefs(rNode.getCoefs(), rNode.getNCoefs());
+                        diff += (iCoefs - c * rCoefs).squaredNorm();
+                    }
+                    if (c > 0.0 and dim * std::sqrt(diff / ii) * bounds[i] <= maxError) {
+                        terms.back().coef += std::pow(c, dim);
+                        nMerged++;
+                        continue;
+                    }
+                }
+            }
+            terms.push_back({i, 1.0});
+        }
+        println(20, "  Depth " << depth << ": " << terms.size() << " of " << nTerms << " terms, " << nMerged << " merged");
+        this->term_lists.push_back(terms);
+    }
+}
+
+/** File header of a stored operator, version 1, followed by one
+ * OperatorTree record per component (see OperatorTree::saveTree) */
+struct MWOperatorHeader {
+    char magic[4]; // "MROP"
+    int version;   // file format version
+    int nComponents;
+    int reserved;  // keeps the tree records 8 byte aligned
+};
+
+static const int mw_operator_version = 1;
+
+/** @brief Write all operator components to disk, for later use
+ * @param[in] file: File name, will get ".oper" extension
+ *
+ * @details Band widths and reduced terms depend on the application
+ * precision and are recomputed by apply, so they are not stored.
+ */
+void MWOperator::saveOperator(const std::string &file) {
+    Timer t1;
+    std::stringstream fname;
+    fname << file << ".oper";
+
+    std::fstream f;
+    f.open(fname.str(), std::ios::out | std::ios::binary);
+    if (not f.is_open()) MSG_ERROR("Unable to open file");
+
+    MWOperatorHeader header{{'M', 'R', 'O', 'P'}, mw_operator_version, size(), 0};
+    f.write((char *)&header, sizeof(MWOperatorHeader));
+    for (auto &i : this->oper_exp) i->saveTree(f);
+    f.close();
+    print::time(10, "Time write operator", t1);
+}
+
+/** @brief Read operator components previously stored with saveOperator
+ * @param[in] file: File name, will get ".oper" extension
+ *
+ * @details The operator must be empty, and defined on the same operator
+ * MRA as the one that was saved. This replaces the projection and cross
+ * correlation of the kernel, e.g. with an empty ConvolutionOperator:
+ *
+ *     ConvolutionOperator<3> P(MRA, prec);
+ *     P.loadOperator("poisson");
+ */
+void MWOperator::loadOperator(const std::string &file) {
+    if (size() != 0) MSG_ABORT("Operator not empty");
+    Timer t1;
+    std::stringstream fname;
+    fname << file << ".oper";
+
+    std::fstream f;
+    f.open(fname.str(), std::ios::in | std::ios::binary);
+    if (not f.is_open()) MSG_ERROR("Unable to open file");
+
+    MWOperatorHeader header;
+    f.read((char *)&header, sizeof(MWOperatorHeader));
+    if (not f or std::string(header.magic, 4) != "MROP") MSG_ABORT("Invalid operator file");
+    if (header.version != mw_operator_version) MSG_ABORT("Unsupported operator version " << header.version);
+
+    for (int n = 0; n < header.nComponents; n++) {
+        // The norm precision is checked by OperatorTree::loadTree
+        std::streampos pos = f.tellg();
+        OperatorTreeHeader tree_header;
+        f.read((char *)&tree_header, sizeof(OperatorTreeHeader));
+        f.seekg(pos);
+
+        auto *o_tree = new OperatorTree(this->oper_mra, tree_header.normPrec);
+        o_tree->loadTree(f);
+        this->oper_exp.push_back(o_tree);
+    }
+    f.close();
+    print::time(10, "Time read operator", t1);
+}
+
 } // namespace mrcpp
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "trees/MultiResolutionAnalysis.h"
@@ -32,6 +33,13 @@
 
 namespace mrcpp {
 
+/** Term of a reduced operator expansion at a given depth: coef times the
+ * tensor product of the component comp in all directions */
+struct OperatorTerm {
+    int comp;
+    double coef;
+};
+
 class MWOperator {
 public:
     MWOperator(const MultiResolutionAnalysis<2> &mra)
@@ -42,7 +50,7 @@ public:
 
     int size() const { return this->oper_exp.size(); }
     void push_back(OperatorTree *oper) { this->oper_exp.push_back(oper); }
-    void clear(bool dealloc = false);
+    virtual void clear(bool dealloc = false);
 
     int getMaxBandWidth(int depth = -1) const;
     const Eigen::VectorXi &getMaxBandWidths() const { return this->band_max; }
@@ -50,6 +58,14 @@ public:
     void calcBandWidths(double prec);
     void clearBandWidths();
 
+    bool hasReducedTerms() const { return not this->term_lists.empty(); }
+    const std::vector<OperatorTerm> &getReducedTerms(int depth) const;
+    void calcReducedTerms(double prec, int dim);
+    void clearReducedTerms() { this->term_lists.clear(); }
+
+    void saveOperator(const std::string &file);
+    void loadOperator(const std::string &file);
+
     OperatorTree &getComponent(int i);
     const OperatorTree &getComponent(int i) const;
 
@@ -60,6 +76,7 @@ protected:
     MultiResolutionAnalysis<2> oper_mra;
     OperatorTreeVector oper_exp;
     Eigen::VectorXi band_max;
+    std::vector<std::vector<OperatorTerm>> term_lists;
 };
 
 } // namespace mrcpp
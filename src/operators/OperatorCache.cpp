@@ -0,0 +1,171 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#include <cmath>
+
+#include "OperatorCache.h"
+#include "utils/Printer.h"
+
+namespace mrcpp {
+
+/** @brief Turn operator caching on or off
+ *
+ *  @details Disabling the cache releases all cached trees.
+ */
+void OperatorCache::setEnabled(bool enable) {
+    this->enabled = enable;
+    if (not this->enabled) clear();
+}
+
+/** @brief Set the maximum memory held by the cache
+ *
+ *  @param[in] kb: Memory limit in kB, over all cached trees
+ *
+ *  @details Least recently used trees above the new limit are released
+ *  immediately.
+ */
+void OperatorCache::setMemoryLimit(int kb) {
+    if (kb < 0) MSG_ABORT("Invalid memory limit");
+#pragma omp critical(operator_cache)
+    {
+        this->memLimit = kb;
+        evict(0);
+    }
+}
+
+/** @brief Set the relative tolerance for matching Gaussian exponents
+ *
+ *  @details Sharing a tree for an exponent that is off by a relative amount
+ *  tol gives an error of the same relative size in that term, the tolerance
+ *  should therefore be small compared to the build precision.
+ */
+void OperatorCache::setTolerance(double tol) {
+    if (tol < 0.0) MSG_ABORT("Invalid tolerance");
+    this->tolerance = tol;
+}
+
+/** @brief Release all cached trees and reset the hit and miss counters */
+void OperatorCache::clear() {
+#pragma omp critical(operator_cache)
+    {
+        this->entries.clear();
+        this->memLoaded = 0;
+        this->nHits = 0;
+        this->nMisses = 0;
+    }
+}
+
+/** @returns Number of cached trees */
+int OperatorCache::getNTrees() {
+    int n = 0;
+#pragma omp critical(operator_cache)
+    n = this->entries.size();
+    return n;
+}
+
+/** @returns Memory held by the cached trees, in kB */
+int OperatorCache::getMem() {
+    int mem = 0;
+#pragma omp critical(operator_cache)
+    mem = this->memLoaded;
+    return mem;
+}
+
+/** @brief Add the tree of a kernel term to the cache
+ *
+ *  @details Trees larger than the memory limit are not cached, otherwise
+ *  the least recently used trees are evicted to make room.
+ */
+void OperatorCache::load(const MultiResolutionAnalysis<2> &oper_mra,
+                         const MultiResolutionAnalysis<1> &kern_mra,
+                         double prec,
+                         double exp,
+                         double coef,
+                         std::shared_ptr<OperatorTree> tree) {
+    if (not this->enabled) return;
+    int memory = tree->getSizeNodes();
+#pragma omp critical(operator_cache)
+    if (memory <= this->memLimit) {
+        evict(memory);
+        this->entries.push_back({oper_mra, kern_mra, prec, exp, coef, tree, memory, ++this->useCount});
+        this->memLoaded += memory;
+    }
+}
+
+/** @brief Find the tree of a kernel term
+ *
+ *  @param[in,out] coef: Requested coefficient on input, coefficient of the
+ *  returned tree on output
+ *
+ *  @returns Tree of the cached term with the closest matching exponent, or
+ *  nullptr if the cache is disabled or no term matches
+ */
+std::shared_ptr<OperatorTree> OperatorCache::get(const MultiResolutionAnalysis<2> &oper_mra,
+                                                 const MultiResolutionAnalysis<1> &kern_mra,
+                                                 double prec,
+                                                 double exp,
+                                                 double &coef) {
+    std::shared_ptr<OperatorTree> tree;
+    if (not this->enabled) return tree;
+#pragma omp critical(operator_cache)
+    {
+        Entry *best = nullptr;
+        double bestDiff = this->tolerance * exp;
+        for (auto &entry : this->entries) {
+            if (entry.prec != prec) continue;
+            if (entry.oper_mra != oper_mra) continue;
+            if (entry.kern_mra != kern_mra) continue;
+            double diff = std::abs(entry.exp - exp);
+            if (diff <= bestDiff) {
+                best = &entry;
+                bestDiff = diff;
+            }
+        }
+        if (best != nullptr) {
+            best->lastUse = ++this->useCount;
+            coef = best->coef;
+            tree = best->tree;
+            this->nHits++;
+        } else {
+            this->nMisses++;
+        }
+    }
+    return tree;
+}
+
+/** Evict least recently used trees until kb more fits below the limit,
+ * must be called within the operator_cache critical section */
+void OperatorCache::evict(int kb) {
+    while (not this->entries.empty() and this->memLoaded + kb > this->memLimit) {
+        auto lru = this->entries.begin();
+        for (auto it = this->entries.begin(); it != this->entries.end(); ++it) {
+            if (it->lastUse < lru->lastUse) lru = it;
+        }
+        this->memLoaded -= lru->memory;
+        this->entries.erase(lru);
+    }
+}
+
+} // namespace mrcpp
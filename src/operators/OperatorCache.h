@@ -0,0 +1,128 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+
+#include "trees/MultiResolutionAnalysis.h"
+#include "trees/OperatorTree.h"
+
+namespace mrcpp {
+
+#define getOperatorCache(X) OperatorCache &X = OperatorCache::getInstance()
+
+/** @class OperatorCache
+ *
+ * @brief Process-wide cache of the OperatorTrees of convolution operators
+ *
+ * @details Each Gaussian term c*exp(-a*x^2) of a GreensKernel is expanded into
+ * an OperatorTree that only depends on the operator and kernel MRAs, the build
+ * precision and the two parameters (a, c). When enabled, ConvolutionOperator
+ * looks up every term here before building it, so operators that are rebuilt
+ * with the same or similar parameters, e.g. a HelmholtzOperator in every SCF
+ * cycle, share their trees instead of recomputing them.
+ *
+ * A term matches a cached one when the MRAs and precision are the same and
+ * the exponents agree within the relative tolerance (exact match by default).
+ * Since the operator grid and the relative kernel projection do not depend on
+ * the coefficient, a matching tree with a different coefficient is reused as
+ * a rescaled copy, see ConvolutionOperator::initializeOperator.
+ *
+ * Trees are held by shared pointers, so evicting a tree from the cache never
+ * invalidates an operator that uses it. The cache memory is bounded by the
+ * memory limit, the least recently used trees are evicted beyond it.
+ *
+ * @note A shared tree is not read-only: every application of an operator
+ * computes and clears the band widths of its trees (calcBandWidths and
+ * clearBandWidths). Two live operators that share a term must therefore not
+ * be applied concurrently, e.g. from different OpenMP threads or tasks.
+ *
+ */
+
+class OperatorCache final {
+public:
+    static OperatorCache &getInstance() {
+        static OperatorCache theOperatorCache;
+        return theOperatorCache;
+    }
+
+    void setEnabled(bool enable);
+    bool isEnabled() const { return this->enabled; }
+
+    void setMemoryLimit(int kb);
+    int getMemoryLimit() const { return this->memLimit; }
+
+    void setTolerance(double tol);
+    double getTolerance() const { return this->tolerance; }
+
+    void clear();
+    void load(const MultiResolutionAnalysis<2> &oper_mra,
+              const MultiResolutionAnalysis<1> &kern_mra,
+              double prec,
+              double exp,
+              double coef,
+              std::shared_ptr<OperatorTree> tree);
+    std::shared_ptr<OperatorTree> get(const MultiResolutionAnalysis<2> &oper_mra,
+                                      const MultiResolutionAnalysis<1> &kern_mra,
+                                      double prec,
+                                      double exp,
+                                      double &coef);
+
+    int getNTrees();
+    int getMem();
+    int getNHits() const { return this->nHits; }
+    int getNMisses() const { return this->nMisses; }
+
+private:
+    struct Entry {
+        MultiResolutionAnalysis<2> oper_mra;
+        MultiResolutionAnalysis<1> kern_mra;
+        double prec;
+        double exp;
+        double coef;
+        std::shared_ptr<OperatorTree> tree;
+        int memory;  // kB
+        long lastUse; // for LRU eviction
+    };
+
+    bool enabled{false};
+    int memLimit{1024 * 1024}; // kB
+    int memLoaded{0};          // kB
+    double tolerance{0.0};
+    long useCount{0};
+    int nHits{0};
+    int nMisses{0};
+    std::list<Entry> entries;
+
+    OperatorCache() = default;
+    OperatorCache(OperatorCache const &oc) = delete;
+    OperatorCache &operator=(OperatorCache const &oc) = delete;
+
+    void evict(int kb);
+};
+
+} // namespace mrcpp
@@ -52,6 +52,7 @@ public:
         this->kp1_dm1 = math_utils::ipow(this->kp1, D - 1);
         this->gData = this->gNode->getCoefs();
         this->maxDeltaL = -1;
+        this->oCoef = 1.0;
 
         double *scr2 = scr1 + this->kp1_d;
 
@@ -96,6 +97,7 @@ private:
     int ft;
     int gt;
     int maxDeltaL;
+    double oCoef;
     double fThreshold;
     double gThreshold;
     // Shorthands
@@ -36,9 +36,15 @@ OperatorStatistics<D>::OperatorStatistics()
         , totFCount(0)
         , totGCount(0)
         , totGenCount(0)
+        , totGemmCount(0)
+        , totBlockCount(0)
+        , totBandCount(0)
         , fCount(nullptr)
         , gCount(nullptr)
         , genCount(nullptr)
+        , gemmCount(nullptr)
+        , blockCount(nullptr)
+        , bandCount(nullptr)
         , totCompCount(nullptr)
         , compCount(nullptr) {
 
@@ -48,6 +54,9 @@ OperatorStatistics<D>::OperatorStatistics()
     this->fCount = new int[this->nThreads];
     this->gCount = new int[this->nThreads];
     this->genCount = new int[this->nThreads];
+    this->gemmCount = new long long[this->nThreads];
+    this->blockCount = new long long[this->nThreads];
+    this->bandCount = new long long[this->nThreads];
     this->compCount = new Matrix<int, 8, 8> *[this->nThreads];
     for (int i = 0; i < this->nThreads; i++) {
         this->compCount[i] = new Matrix<int, 8, 8>;
@@ -55,6 +64,9 @@ OperatorStatistics<D>::OperatorStatistics()
         this->fCount[i] = 0;
         this->gCount[i] = 0;
         this->genCount[i] = 0;
+        this->gemmCount[i] = 0;
+        this->blockCount[i] = 0;
+        this->bandCount[i] = 0;
     }
 }
 
@@ -64,6 +76,9 @@ template <int D> OperatorStatistics<D>::~OperatorStatistics() {
     delete[] this->fCount;
     delete[] this->gCount;
     delete[] this->genCount;
+    delete[] this->gemmCount;
+    delete[] this->blockCount;
+    delete[] this->bandCount;
     delete totCompCount;
 }
 
@@ -73,10 +88,16 @@ template <int D> void OperatorStatistics<D>::flushNodeCounters() {
         this->totFCount += this->fCount[i];
         this->totGCount += this->gCount[i];
         this->totGenCount += this->genCount[i];
+        this->totGemmCount += this->gemmCount[i];
+        this->totBlockCount += this->blockCount[i];
+        this->totBandCount += this->bandCount[i];
         *this->totCompCount += *this->compCount[i];
         this->fCount[i] = 0;
         this->gCount[i] = 0;
         this->genCount[i] = 0;
+        this->gemmCount[i] = 0;
+        this->blockCount[i] = 0;
+        this->bandCount[i] = 0;
         this->compCount[i]->setZero();
     }
 }
@@ -95,12 +116,31 @@ template <int D> void OperatorStatistics<D>::incrementFNodeCounters(const MWNode
     if (fNode.isGenNode()) { this->genCount[thread]++; }
 }
 
+/** Increment matrix product counters. Blocks are counted in units of a single
+ * (kp1^(D-1) x kp1) by (kp1 x kp1) product, a batched product counts as one
+ * call but as many blocks as it has operator nodes. */
+template <int D> void OperatorStatistics<D>::incrementGemmCounters(int calls, int blocks) {
+    int thread = omp_get_thread_num();
+    this->gemmCount[thread] += calls;
+    this->blockCount[thread] += blocks;
+}
+
+/** Increment the counter of f-nodes in the operator bands that are screened
+ * component by component. */
+template <int D> void OperatorStatistics<D>::incrementBandCounters(int n) {
+    int thread = omp_get_thread_num();
+    this->bandCount[thread] += n;
+}
+
 template <int D> std::ostream &OperatorStatistics<D>::print(std::ostream &o) const {
     o << std::setw(8);
     o << "*OperatorFunc statistics: " << std::endl << std::endl;
     o << "  Total calculated gNodes      : " << this->totGCount << std::endl;
+    o << "  Total band fNodes            : " << this->totBandCount << std::endl;
     o << "  Total applied fNodes         : " << this->totFCount << std::endl;
-    o << "  Total applied genNodes       : " << this->totGenCount << std::endl << std::endl;
+    o << "  Total applied genNodes       : " << this->totGenCount << std::endl;
+    o << "  Total matrix products        : " << this->totGemmCount << std::endl;
+    o << "  Total matrix product blocks  : " << this->totBlockCount << std::endl << std::endl;
     o << "  By components:" << std::endl << *this->totCompCount << std::endl;
     return o;
 }
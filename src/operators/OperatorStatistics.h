@@ -40,6 +40,8 @@ public:
     void flushNodeCounters();
     void incrementFNodeCounters(const MWNode<D> &fNode, int ft, int gt);
     void incrementGNodeCounters(const MWNode<D> &gNode);
+    void incrementGemmCounters(int calls, int blocks);
+    void incrementBandCounters(int n);
 
     friend std::ostream &operator<<(std::ostream &o, const OperatorStatistics &os) { return os.print(o); }
 
@@ -48,9 +50,15 @@ protected:
     int totFCount;
     int totGCount;
     int totGenCount;
+    long long totGemmCount;
+    long long totBlockCount;
+    long long totBandCount;
     int *fCount;
     int *gCount;
     int *genCount;
+    long long *gemmCount;
+    long long *blockCount;
+    long long *bandCount;
     Eigen::Matrix<int, 8, 8> *totCompCount;
     Eigen::Matrix<int, 8, 8> **compCount;
 
@@ -25,31 +25,38 @@
 
 #pragma once
 
+#include <vector>
+
+#include <Eigen/Core>
+
 #include "TreeCalculator.h"
 #include "trees/FunctionTreeVector.h"
+#include "utils/omp_utils.h"
 
 namespace mrcpp {
 
 template <int D> class AdditionCalculator final : public TreeCalculator<D> {
 public:
     AdditionCalculator(const FunctionTreeVector<D> &inp)
-            : sum_vec(inp) {}
+            : sum_vec(inp)
+            , coefs(omp_get_max_threads()) {}
 
 private:
     FunctionTreeVector<D> sum_vec;
+    std::vector<Eigen::VectorXd> coefs; // per-thread scratch for the input coefs
 
     void calcNode(MWNode<D> &node_o) override {
         node_o.zeroCoefs();
         const NodeIndex<D> &idx = node_o.getNodeIndex();
         double *coefs_o = node_o.getCoefs();
+        int n_coefs = node_o.getNCoefs();
+        Eigen::VectorXd &coefs_i = this->coefs[omp_get_thread_num()];
+        if (coefs_i.size() != n_coefs) coefs_i.resize(n_coefs);
         for (int i = 0; i < this->sum_vec.size(); i++) {
             double c_i = get_coef(this->sum_vec, i);
             FunctionTree<D> &func_i = get_func(this->sum_vec, i);
-            // This generates missing nodes
-            const MWNode<D> &node_i = func_i.getNode(idx);
-            const double *coefs_i = node_i.getCoefs();
-            int n_coefs = node_i.getNCoefs();
-            for (int j = 0; j < n_coefs; j++) { coefs_o[j] += c_i * coefs_i[j]; }
+            func_i.getNodeCoefs(idx, coefs_i.data());
+            for (int j = 0; j < n_coefs; j++) { coefs_o[j] += c_i * coefs_i(j); }
         }
         node_o.setHasCoefs();
         node_o.calcNorms();
@@ -23,6 +23,8 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <algorithm>
+
 #include "ConvolutionCalculator.h"
 #include "operators/ConvolutionOperator.h"
 #include "operators/OperatorState.h"
@@ -31,6 +33,7 @@
 #include "trees/OperatorNode.h"
 #include "utils/Printer.h"
 #include "utils/Timer.h"
+#include "utils/periodic_utils.h"
 
 #ifdef HAVE_BLAS
 extern "C" {
@@ -43,15 +46,36 @@ using Eigen::MatrixXi;
 
 namespace mrcpp {
 
+static ConvolutionKernel convolution_kernel = ConvolutionKernel::Generic;
+
+/** Select the kernel used by all subsequently constructed ConvolutionCalculators */
+void set_convolution_kernel(ConvolutionKernel kernel) {
+    convolution_kernel = kernel;
+}
+
+ConvolutionKernel get_convolution_kernel() {
+    return convolution_kernel;
+}
+
 template <int D>
 ConvolutionCalculator<D>::ConvolutionCalculator(double p, ConvolutionOperator<D> &o, FunctionTree<D> &f, int depth)
         : maxDepth(depth)
+        , kernel(convolution_kernel)
         , prec(p)
         , oper(&o)
         , fTree(&f) {
     if (this->maxDepth > MaxDepth) MSG_ABORT("Beyond MaxDepth");
     initBandSizes();
+    initBandStencils();
+    initTermLists();
+    initOperBounds();
+    initSubtreeNorms();
     initTimers();
+    this->fBands.resize(omp_get_max_threads());
+    this->idxBands.resize(omp_get_max_threads());
+    if (this->kernel == ConvolutionKernel::Batched) {
+        this->batches.resize(omp_get_max_threads(), std::vector<OperBatch>(this->nComp));
+    }
 }
 
 template <int D> ConvolutionCalculator<D>::~ConvolutionCalculator() {
@@ -134,63 +158,208 @@ template <int D> void ConvolutionCalculator<D>::calcBandSizeFactor(MatrixXi &bs,
     bs(depth, this->nComp2) = bs.row(depth).maxCoeff();
 }
 
-/** Return a vector of nodes in F affected by O, given a node in G */
-template <int D>
-MWNodeVector<D> *ConvolutionCalculator<D>::makeOperBand(const MWNode<D> &gNode, std::vector<NodeIndex<D>> &idx_band) {
-    auto *band = new MWNodeVector<D>;
+/** Precompute the translation offsets within the bandwidth of the operator
+ at each depth, with the first direction running fastest. In non-periodic
+ worlds the offsets are limited to the number of boxes in each direction. */
+template <int D> void ConvolutionCalculator<D>::initBandStencils() {
+    const NodeBox<D> &fWorld = this->fTree->getRootBox();
+    bool periodic = this->fTree->getMRA().getWorldBox().isPeriodic();
+    for (int depth = 0; depth < this->maxDepth; depth++) {
+        std::vector<std::array<int, D>> stencil;
+        int width = this->oper->getMaxBandWidth(depth);
+        if (width >= 0) {
+            int w[D];
+            int nTot = 1;
+            for (int i = 0; i < D; i++) {
+                w[i] = width;
+                long long nboxes = (long long)fWorld.size(i) << depth;
+                if (not periodic and w[i] > nboxes - 1) { w[i] = (int)(nboxes - 1); }
+                nTot *= 2 * w[i] + 1;
+            }
+            stencil.resize(nTot);
+            for (int n = 0; n < nTot; n++) {
+                int r = n;
+                for (int i = 0; i < D; i++) {
+                    stencil[n][i] = r % (2 * w[i] + 1) - w[i];
+                    r /= 2 * w[i] + 1;
+                }
+            }
+        }
+        this->bandStencils.push_back(stencil);
+    }
+}
 
-    int depth = gNode.getDepth();
-    bool periodic = gNode.getMWTree().getMRA().getWorldBox().isPeriodic();
-    int width = this->oper->getMaxBandWidth(depth);
-    if (width >= 0) {
-        const NodeBox<D> &fWorld = this->fTree->getRootBox();
-        const NodeIndex<D> &cIdx = fWorld.getCornerIndex();
-        const NodeIndex<D> &gIdx = gNode.getNodeIndex();
-
-        int l_start[D];
-        int l_end[D];
-        int nbox[D];
-        for (int i = 0; i < D; i++) {
-            l_start[i] = gIdx.getTranslation(i) - width;
-            l_end[i] = gIdx.getTranslation(i) + width;
-            // We need to consider the world borders
-            int nboxes = fWorld.size(i) * (1 << depth);
-            int c_i = cIdx.getTranslation(i) * (1 << depth);
-            if (l_start[i] < c_i and !periodic) { l_start[i] = c_i; }
-            if (l_end[i] > c_i + nboxes - 1 and !periodic) { l_end[i] = c_i + nboxes - 1; }
-            nbox[i] = l_end[i] - l_start[i] + 1;
+/** Terms of the operator expansion to apply at each depth: the reduced
+ * expansion of the operator if it has one, otherwise all components. */
+template <int D> void ConvolutionCalculator<D>::initTermLists() {
+    for (int depth = 0; depth < this->maxDepth; depth++) {
+        std::vector<OperatorTerm> terms;
+        if (this->oper->hasReducedTerms()) {
+            if (depth < this->oper->getMaxBandWidths().size()) terms = this->oper->getReducedTerms(depth);
+        } else {
+            for (int i = 0; i < this->oper->size(); i++) terms.push_back({i, 1.0});
         }
+        this->termLists.push_back(terms);
+    }
+}
 
-        int scale = gNode.getScale();
-        NodeIndex<D> idx(scale, l_start);
+/** Upper bound, at each depth, of the screening estimate oNorm * fThreshold
+ of applyOperator per unit f-norm: the largest operator component norm within
+ the bandwidth to the power D, times the largest band size factor. */
+template <int D> void ConvolutionCalculator<D>::initOperBounds() {
+    for (int depth = 0; depth < this->maxDepth; depth++) {
+        double bound = 0.0;
+        for (const auto &term : this->termLists[depth]) {
+            int i = term.comp;
+            const OperatorTree &oTree = this->oper->getComponent(i);
+            int width = oTree.getBandWidth().getMaxWidth(depth);
+            if (width < 0) continue;
+            double oMax = 0.0;
+            for (int l = -width; l <= width; l++) {
+                const OperatorNode &oNode = oTree.getNode(depth, l);
+                for (int k = 0; k < 4; k++) oMax = std::max(oMax, oNode.getComponentNorm(k));
+            }
+            double bsMax = (*this->bandSizes[i])(depth, this->nComp2);
+            bound = std::max(bound, term.coef * std::pow(oMax, D) * bsMax);
+        }
+        this->operBounds.push_back(bound);
+    }
+}
 
-        fillOperBand(band, idx_band, idx, nbox, D - 1);
+/** Norm of the input function restricted to the support of each f-node,
+ * indexed by the serial index of the node. This bounds the component norms of
+ * all the descendants of the node, existing or generated. */
+template <int D> static double calc_subtree_norms(const MWNode<D> &node, std::vector<double> &norms) {
+    double sqNorm = 0.0;
+    if (node.isEndNode()) {
+        sqNorm = node.getSquareNorm();
+    } else {
+        for (int i = 0; i < node.getTDim(); i++) sqNorm += calc_subtree_norms(node.getMWChild(i), norms);
     }
-    return band;
+    int sIdx = node.getSerialIx();
+    if (sIdx >= norms.size()) norms.resize(sIdx + 1, -1.0);
+    norms[sIdx] = std::sqrt(sqNorm);
+    return sqNorm;
 }
 
-/** Recursively retrieve all reachable f-nodes within the bandwidth. */
+template <int D> void ConvolutionCalculator<D>::initSubtreeNorms() {
+    for (int i = 0; i < this->fTree->getRootBox().size(); i++) {
+        calc_subtree_norms(this->fTree->getRootMWNode(i), this->fSubtreeNorms);
+    }
+}
+
+/** A GenNode is polynomial on its support, so its own norm is exact. */
+template <int D> double ConvolutionCalculator<D>::getSubtreeNorm(const MWNode<D> &fNode) const {
+    if (fNode.isGenNode()) return std::sqrt(fNode.getSquareNorm());
+    return this->fSubtreeNorms[fNode.getSerialIx()];
+}
+
+/** Collect the nodes in F affected by O, given a node in G. Instead of a
+ * descent from the root for each node, the band is resolved by walking from
+ * the f-node of the parent of the g-node to each neighbour in turn. Nodes
+ * that cannot pass the screening in applyOperator are left out, see
+ * findBandNode. */
 template <int D>
-void ConvolutionCalculator<D>::fillOperBand(MWNodeVector<D> *band,
+void ConvolutionCalculator<D>::makeOperBand(const MWNode<D> &gNode,
+                                            MWNodeVector<D> &band,
                                             std::vector<NodeIndex<D>> &idx_band,
-                                            NodeIndex<D> &idx,
-                                            const int *nbox,
-                                            int dim) {
+                                            double gThrs) {
+    band.clear();
+    idx_band.clear();
+
+    int depth = gNode.getDepth();
+    if (depth >= this->bandStencils.size()) return;
+    const std::vector<std::array<int, D>> &stencil = this->bandStencils[depth];
+    if (stencil.empty()) return;
+
+    // Smallest f-norm that can pass the screening at this depth
+    double fThrs = -1.0;
+    if (this->operBounds[depth] > 0.0) fThrs = gThrs / this->operBounds[depth];
+
+    bool periodic = gNode.getMWTree().getMRA().getWorldBox().isPeriodic();
+    const NodeBox<D> &fWorld = this->fTree->getRootBox();
+    const NodeIndex<D> &cIdx = fWorld.getCornerIndex();
+    const NodeIndex<D> &gIdx = gNode.getNodeIndex();
+
+    // We need to consider the world borders
+    int l_min[D];
+    int l_max[D];
+    for (int i = 0; i < D; i++) {
+        l_min[i] = cIdx.getTranslation(i) * (1 << depth);
+        l_max[i] = l_min[i] + fWorld.size(i) * (1 << depth) - 1;
+    }
+
+    MWNode<D> *fNear = nullptr;
+    if (depth > 0) {
+        fNear = &this->fTree->getNodeOrEndNode(gNode.getMWParent().getNodeIndex());
+    } else {
+        fNear = &this->fTree->getRootMWNode(this->fTree->getRootIndex(gIdx));
+    }
+    const MWNode<D> *fSkip = nullptr;
+
+    NodeIndex<D> idx(gNode.getScale());
     int *l = idx.getTranslation();
-    int l_start = l[dim];
-    for (int j = 0; j < nbox[dim]; j++) {
-        // Recurse until dim == 0
-        if (dim > 0) {
-            fillOperBand(band, idx_band, idx, nbox, dim - 1);
-            l[dim]++;
-            continue;
+    for (const auto &offset : stencil) {
+        bool inside = true;
+        for (int i = 0; i < D; i++) {
+            l[i] = gIdx.getTranslation(i) + offset[i];
+            if (not periodic and (l[i] < l_min[i] or l[i] > l_max[i])) inside = false;
         }
-        MWNode<D> &fNode = this->fTree->getNode(idx);
+        if (not inside) continue;
+        MWNode<D> *fNode = findBandNode(idx, fNear, fSkip, fThrs);
+        if (fNode == nullptr) continue;
         idx_band.push_back(idx);
-        band->push_back(&fNode);
-        l[dim]++;
+        band.push_back(fNode);
     }
-    l[dim] = l_start;
+}
+
+/** Find the f-node with the given index, starting from the nearby node fNear.
+ * On the way down, the norm of f below each existing node is compared with
+ * fThrs: if it is smaller, no node in this subtree can pass the screening. The
+ * subtree root is then kept in fSkip, so that the following band members in
+ * the same subtree are dropped at once, and nullptr is returned. Nodes are only
+ * generated when they are not screened away. */
+template <int D>
+MWNode<D> *ConvolutionCalculator<D>::findBandNode(const NodeIndex<D> &idx,
+                                                  MWNode<D> *&fNear,
+                                                  const MWNode<D> *&fSkip,
+                                                  double fThrs) {
+    NodeIndex<D> fIdx(idx);
+    const BoundingBox<D> &fWorld = this->fTree->getRootBox();
+    if (fWorld.isPeriodic()) { periodic::indx_manipulation<D>(fIdx, fWorld.getPeriodic()); }
+    if (fSkip != nullptr and fSkip->isAncestor(fIdx)) return nullptr;
+
+    MWNode<D> *node = fNear;
+    while (not node->isAncestor(fIdx)) {
+        if (node->getDepth() == 0) {
+            node = &this->fTree->getRootMWNode(this->fTree->getRootIndex(fIdx));
+            break;
+        }
+        node = &node->getMWParent();
+    }
+    // Descend through the existing part of the tree
+    while (node->getScale() < fIdx.getScale() and not node->isGenNode() and not node->isEndNode()) {
+        if (getSubtreeNorm(*node) <= fThrs) {
+            fNear = node;
+            fSkip = node;
+            return nullptr;
+        }
+        int diffScale = fIdx.getScale() - node->getScale() - 1;
+        int cIdx = 0;
+        for (int d = 0; d < D; d++) cIdx += ((fIdx.getTranslation(d) >> diffScale) & 1) << d;
+        node = &node->getMWChild(cIdx);
+    }
+    if (node->getScale() < fIdx.getScale()) {
+        if (getSubtreeNorm(*node) <= fThrs) {
+            fNear = node;
+            fSkip = node;
+            return nullptr;
+        }
+        node = &this->fTree->getNode(fIdx, *node);
+    }
+    fNear = node;
+    if (std::sqrt(node->getSquareNorm()) <= fThrs) return nullptr;
+    return node;
 }
 
 template <int D> int ConvolutionCalculator<D>::getBandSizeFactor(int i, int depth, const OperatorState<D> &os) const {
@@ -210,12 +379,6 @@ template <int D> void ConvolutionCalculator<D>::calcNode(MWNode<D> &node) {
     OperatorState<D> os(gNode, tmpCoefs);
     this->operStat.incrementGNodeCounters(gNode);
 
-    // Get all nodes in f within the bandwith of O in g
-    this->band_t[omp_get_thread_num()]->resume();
-    std::vector<NodeIndex<D>> idx_band;
-    MWNodeVector<D> *fBand = makeOperBand(gNode, idx_band);
-    this->band_t[omp_get_thread_num()]->stop();
-
     MWTree<D> &gTree = gNode.getMWTree();
     double gThrs = gTree.getSquareNorm();
     if (gThrs > 0.0) {
@@ -224,9 +387,17 @@ template <int D> void ConvolutionCalculator<D>::calcNode(MWNode<D> &node) {
     }
     os.gThreshold = gThrs;
 
+    // Get all nodes in f within the bandwith of O in g
+    this->band_t[omp_get_thread_num()]->resume();
+    std::vector<NodeIndex<D>> &idx_band = this->idxBands[omp_get_thread_num()];
+    MWNodeVector<D> &fBand = this->fBands[omp_get_thread_num()];
+    makeOperBand(gNode, fBand, idx_band, gThrs);
+    this->band_t[omp_get_thread_num()]->stop();
+    this->operStat.incrementBandCounters(fBand.size());
+
     this->calc_t[omp_get_thread_num()]->resume();
-    for (int n = 0; n < fBand->size(); n++) {
-        MWNode<D> &fNode = *(*fBand)[n];
+    for (int n = 0; n < fBand.size(); n++) {
+        MWNode<D> &fNode = *fBand[n];
         NodeIndex<D> &fIdx = idx_band[n];
         os.setFNode(fNode);
         os.setFIndex(fIdx);
@@ -242,24 +413,26 @@ template <int D> void ConvolutionCalculator<D>::calcNode(MWNode<D> &node) {
             }
         }
     }
+    if (this->kernel == ConvolutionKernel::Batched) { flushOperBatches(gNode); }
     this->calc_t[omp_get_thread_num()]->stop();
 
     this->norm_t[omp_get_thread_num()]->resume();
     gNode.calcNorms();
     this->norm_t[omp_get_thread_num()]->stop();
-    delete fBand;
 }
 
 /** Apply each component (term) of the operator expansion to a node in f */
 template <int D> void ConvolutionCalculator<D>::applyOperComp(OperatorState<D> &os) {
     int depth = os.gNode->getDepth();
     double fNorm = os.fNode->getComponentNorm(os.ft);
-    for (int i = 0; i < this->oper->size(); i++) {
+    for (const auto &term : this->termLists[depth]) {
+        int i = term.comp;
         const OperatorTree &ot = this->oper->getComponent(i);
         const BandWidth &bw = ot.getBandWidth();
         if (os.getMaxDeltaL() > bw.getMaxWidth(depth)) { continue; }
         os.oTree = &ot;
-        os.fThreshold = getBandSizeFactor(i, depth, os) * fNorm;
+        os.oCoef = term.coef;
+        os.fThreshold = term.coef * getBandSizeFactor(i, depth, os) * fNorm;
         applyOperator(os);
     }
 }
@@ -298,18 +471,31 @@ template <int D> void ConvolutionCalculator<D>::applyOperator(OperatorState<D> &
     double upperBound = oNorm * os.fThreshold;
     if (upperBound > os.gThreshold) {
         this->operStat.incrementFNodeCounters(fNode, os.ft, os.gt);
-        tensorApplyOperComp(os);
+        switch (this->kernel) {
+            case ConvolutionKernel::Batched:
+                batchApplyOperComp(os);
+                break;
+            case ConvolutionKernel::FixedSize:
+                if (not tensorApplyOperCompFixed(os)) { tensorApplyOperComp(os); }
+                this->operStat.incrementGemmCounters(D, D);
+                break;
+            default:
+                tensorApplyOperComp(os);
+                this->operStat.incrementGemmCounters(D, D);
+        }
     }
 }
 
 /** Perorm the required linear algebra operations in order to apply an
-operator component to a f-node in a n-dimensional tesor space. */
-template <int D> void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorState<D> &os) {
+operator component to a f-node in a n-dimensional tesor space. Only the
+first nDir directions are applied, the result is added up into g only if
+nDir == D. */
+template <int D> void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorState<D> &os, int nDir) {
     double **aux = os.getAuxData();
     double **oData = os.getOperData();
 #ifdef HAVE_BLAS
     double mult = 0.0;
-    for (int i = 0; i < D; i++) {
+    for (int i = 0; i < nDir; i++) {
         if (oData[i] != 0) {
             if (i == D - 1) { // Last dir: Add up into g
                 mult = 1.0;
@@ -322,7 +508,7 @@ template <int D> void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorStat
                         os.kp1_dm1,
                         os.kp1,
                         os.kp1,
-                        1.0,
+                        (i == D - 1) ? os.oCoef : 1.0,
                         f,
                         os.kp1,
                         oData[i],
@@ -336,7 +522,7 @@ template <int D> void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorStat
             Eigen::Map<MatrixXd> g(aux[i + 1], os.kp1_dm1, os.kp1);
             if (oData[i] == 0) {
                 if (i == D - 1) { // Last dir: Add up into g
-                    g += f.transpose();
+                    g += os.oCoef * f.transpose();
                 } else {
                     g = f.transpose();
                 }
@@ -344,26 +530,167 @@ template <int D> void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorStat
         }
     }
 #else
-    for (int i = 0; i < D; i++) {
+    for (int i = 0; i < nDir; i++) {
         Eigen::Map<MatrixXd> f(aux[i], os.kp1, os.kp1_dm1);
         Eigen::Map<MatrixXd> g(aux[i + 1], os.kp1_dm1, os.kp1);
         if (oData[i] != nullptr) {
             Eigen::Map<MatrixXd> op(oData[i], os.kp1, os.kp1);
             if (i == D - 1) { // Last dir: Add up into g
-                g += f.transpose() * op;
+                g += os.oCoef * f.transpose() * op;
             } else {
                 g = f.transpose() * op;
             }
         } else {
             // Identity operator in direction i
             if (i == D - 1) { // Last dir: Add up into g
-                g += f.transpose();
+                g += os.oCoef * f.transpose();
+            } else {
+                g = f.transpose();
+            }
+        }
+    }
+#endif
+}
+
+static constexpr int const_ipow(int m, int e) {
+    int result = 1;
+    for (int i = 0; i < e; i++) { result *= m; }
+    return result;
+}
+
+/** Fixed-size version of tensorApplyOperComp, the sizes of all matrix products
+are known at compile time for kp1 = K. */
+template <int D, int K> static void tensor_apply_fixed(double **aux, double **oData, double oCoef, int nDir) {
+    constexpr int K_dm1 = const_ipow(K, D - 1);
+    using FMatrix = Eigen::Matrix<double, K, K_dm1>;
+    using GMatrix = Eigen::Matrix<double, K_dm1, K>;
+    using OMatrix = Eigen::Matrix<double, K, K>;
+    for (int i = 0; i < nDir; i++) {
+        Eigen::Map<const FMatrix> f(aux[i]);
+        Eigen::Map<GMatrix> g(aux[i + 1]);
+        if (oData[i] != nullptr) {
+            Eigen::Map<const OMatrix> op(oData[i]);
+            if (i == D - 1) { // Last dir: Add up into g
+                g.noalias() += oCoef * f.transpose() * op;
+            } else {
+                g.noalias() = f.transpose() * op;
+            }
+        } else {
+            // Identity operator in direction i
+            if (i == D - 1) { // Last dir: Add up into g
+                g += oCoef * f.transpose();
             } else {
                 g = f.transpose();
             }
         }
     }
+}
+
+/** Dispatch to the fixed-size kernel matching the order of the basis.
+Returns false if there is no kernel for this order. */
+template <int D> bool ConvolutionCalculator<D>::tensorApplyOperCompFixed(OperatorState<D> &os, int nDir) {
+    double **aux = os.getAuxData();
+    double **oData = os.getOperData();
+    switch (os.kp1) {
+        case 2:
+            tensor_apply_fixed<D, 2>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 3:
+            tensor_apply_fixed<D, 3>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 4:
+            tensor_apply_fixed<D, 4>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 5:
+            tensor_apply_fixed<D, 5>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 6:
+            tensor_apply_fixed<D, 6>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 7:
+            tensor_apply_fixed<D, 7>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 8:
+            tensor_apply_fixed<D, 8>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 9:
+            tensor_apply_fixed<D, 9>(aux, oData, os.oCoef, nDir);
+            return true;
+        case 10:
+            tensor_apply_fixed<D, 10>(aux, oData, os.oCoef, nDir);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/** Apply all but the last direction, and add the result to the batch of the
+g-component, in the block of the operator node of the last direction. The
+last direction is applied by flushOperBatches once the band is done. */
+template <int D> void ConvolutionCalculator<D>::batchApplyOperComp(OperatorState<D> &os) {
+    if (not tensorApplyOperCompFixed(os, D - 1)) { tensorApplyOperComp(os, D - 1); }
+    this->operStat.incrementGemmCounters(D - 1, D - 1);
+
+    OperBatch &batch = this->batches[omp_get_thread_num()][os.gt];
+    const double *oData = os.getOperData()[D - 1];
+    int n = std::find(batch.oData.begin(), batch.oData.end(), oData) - batch.oData.begin();
+    if (n == batch.oData.size()) {
+        batch.oData.push_back(oData);
+        batch.coefs.resize((n + 1) * os.kp1_d, 0.0);
+    }
+    Eigen::Map<MatrixXd> f(os.getAuxData()[D - 1], os.kp1, os.kp1_dm1);
+    Eigen::Map<MatrixXd> g(batch.coefs.data() + n * os.kp1_d, os.kp1_dm1, os.kp1);
+    g += os.oCoef * f.transpose();
+}
+
+/** Apply the last direction of all batched contributions to the g-node, with
+a single matrix product per g-component: the summed inputs of the operator
+nodes are stacked along the inner dimension of the product. */
+template <int D> void ConvolutionCalculator<D>::flushOperBatches(MWNode<D> &gNode) {
+    int kp1 = gNode.getKp1();
+    int kp1_d = gNode.getKp1_d();
+    int kp1_dm1 = kp1_d / kp1;
+    for (int gt = 0; gt < this->nComp; gt++) {
+        OperBatch &batch = this->batches[omp_get_thread_num()][gt];
+        int nBlocks = batch.oData.size();
+        if (nBlocks == 0) continue;
+
+        int nInner = nBlocks * kp1;
+        batch.oStack.resize(nInner * kp1);
+        Eigen::Map<MatrixXd> op(batch.oStack.data(), nInner, kp1);
+        for (int n = 0; n < nBlocks; n++) {
+            if (batch.oData[n] != nullptr) {
+                op.middleRows(n * kp1, kp1) = Eigen::Map<const MatrixXd>(batch.oData[n], kp1, kp1);
+            } else {
+                // Identity operator in the last direction
+                op.middleRows(n * kp1, kp1).setIdentity();
+            }
+        }
+        double *gData = gNode.getCoefs() + gt * kp1_d;
+#ifdef HAVE_BLAS
+        cblas_dgemm(CblasColMajor,
+                    CblasNoTrans,
+                    CblasNoTrans,
+                    kp1_dm1,
+                    kp1,
+                    nInner,
+                    1.0,
+                    batch.coefs.data(),
+                    kp1_dm1,
+                    batch.oStack.data(),
+                    nInner,
+                    1.0,
+                    gData,
+                    kp1_dm1);
+#else
+        Eigen::Map<MatrixXd> f(batch.coefs.data(), kp1_dm1, nInner);
+        Eigen::Map<MatrixXd> g(gData, kp1_dm1, kp1);
+        g.noalias() += f * op;
 #endif
+        this->operStat.incrementGemmCounters(1, nBlocks);
+        batch.oData.clear();
+        batch.coefs.clear();
+    }
 }
 
 template <int D> MWNodeVector<D> *ConvolutionCalculator<D>::getInitialWorkVector(MWTree<D> &tree) const {
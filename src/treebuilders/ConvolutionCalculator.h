@@ -25,13 +25,27 @@
 
 #pragma once
 
+#include <array>
+
 #include "TreeCalculator.h"
+#include "operators/MWOperator.h"
 #include "operators/OperatorStatistics.h"
 
 #include "MRCPP/mrcpp_declarations.h"
 
 namespace mrcpp {
 
+/** Kernel used to apply the operator terms to the f-nodes. Generic issues one
+ * dynamically sized matrix product per direction and contribution. FixedSize
+ * does the same with products of compile-time size for kp1 <= 10. Batched
+ * also uses the fixed-size products, but delays the last direction: all
+ * contributions to a g-component are accumulated per operator node and
+ * applied with a single matrix product per g-component and g-node. */
+enum class ConvolutionKernel { Generic, FixedSize, Batched };
+
+void set_convolution_kernel(ConvolutionKernel kernel);
+ConvolutionKernel get_convolution_kernel();
+
 template <int D> class ConvolutionCalculator final : public TreeCalculator<D> {
 public:
     ConvolutionCalculator(double p, ConvolutionOperator<D> &o, FunctionTree<D> &f, int depth = MaxDepth);
@@ -40,7 +54,18 @@ public:
     MWNodeVector<D> *getInitialWorkVector(MWTree<D> &tree) const override;
 
 private:
+    /** Input to the last direction for a single g-component, summed over all
+     * contributions that share the same operator node in that direction. The
+     * few blocks of a band are found by linear search in oData, the vectors
+     * keep their capacity between g-nodes. */
+    struct OperBatch {
+        std::vector<const double *> oData;
+        std::vector<double> coefs;
+        std::vector<double> oStack;
+    };
+
     int maxDepth;
+    ConvolutionKernel kernel;
     double prec;
     ConvolutionOperator<D> *oper;
     FunctionTree<D> *fTree;
@@ -50,16 +75,27 @@ private:
 
     OperatorStatistics<D> operStat;
     std::vector<Eigen::MatrixXi *> bandSizes;
+    std::vector<std::vector<std::array<int, D>>> bandStencils;
+    std::vector<std::vector<OperatorTerm>> termLists;
+    std::vector<double> operBounds;
+    std::vector<double> fSubtreeNorms;
+    std::vector<MWNodeVector<D>> fBands;
+    std::vector<std::vector<NodeIndex<D>>> idxBands;
+    std::vector<std::vector<OperBatch>> batches;
 
     static const int nComp = (1 << D);
     static const int nComp2 = (1 << D) * (1 << D);
 
-    MWNodeVector<D> *makeOperBand(const MWNode<D> &gNode, std::vector<NodeIndex<D>> &idx_band);
-    void fillOperBand(MWNodeVector<D> *band,
+    void initBandStencils();
+    void initTermLists();
+    void initOperBounds();
+    void initSubtreeNorms();
+    double getSubtreeNorm(const MWNode<D> &fNode) const;
+    void makeOperBand(const MWNode<D> &gNode,
+                      MWNodeVector<D> &band,
                       std::vector<NodeIndex<D>> &idx_band,
-                      NodeIndex<D> &idx,
-                      const int *nbox,
-                      int dim);
+                      double gThrs);
+    MWNode<D> *findBandNode(const NodeIndex<D> &idx, MWNode<D> *&fNear, const MWNode<D> *&fSkip, double fThrs);
 
     void initTimers();
     void clearTimers();
@@ -78,7 +114,10 @@ private:
 
     void applyOperComp(OperatorState<D> &os);
     void applyOperator(OperatorState<D> &os);
-    void tensorApplyOperComp(OperatorState<D> &os);
+    void tensorApplyOperComp(OperatorState<D> &os, int nDir = D);
+    bool tensorApplyOperCompFixed(OperatorState<D> &os, int nDir = D);
+    void batchApplyOperComp(OperatorState<D> &os);
+    void flushOperBatches(MWNode<D> &gNode);
 };
 
 } // namespace mrcpp
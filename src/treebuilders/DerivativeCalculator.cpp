@@ -200,6 +200,7 @@ template <int D> void DerivativeCalculator<D>::applyOperator(OperatorState<D> &o
     }
     this->operStat.incrementFNodeCounters(fNode, os.ft, os.gt);
     tensorApplyOperComp(os);
+    this->operStat.incrementGemmCounters(1, 1);
 }
 
 /** Perorm the required linear algebra operations in order to apply an
@@ -25,33 +25,55 @@
 
 #pragma once
 
+#include <vector>
+
+#include <Eigen/Core>
+
 #include "TreeCalculator.h"
 #include "trees/FunctionTreeVector.h"
+#include "utils/omp_utils.h"
 
 namespace mrcpp {
 
+/** Calculator for the product of the functions in a FunctionTreeVector.
+ * Input trees that appear several times in the product are transformed to
+ * value space only once per node, and the numerical coefficients are
+ * collected into a single prefactor. */
 template <int D> class MultiplicationCalculator final : public TreeCalculator<D> {
 public:
     MultiplicationCalculator(const FunctionTreeVector<D> &inp)
-            : prod_vec(inp) {}
+            : values(omp_get_max_threads()) {
+        for (int i = 0; i < inp.size(); i++) {
+            FunctionTree<D> *tree = std::get<1>(inp[i]);
+            this->coef *= get_coef(inp, i);
+            int t = 0;
+            while (t < this->trees.size() and this->trees[t] != tree) t++;
+            if (t == this->trees.size()) {
+                this->trees.push_back(tree);
+                this->powers.push_back(0);
+            }
+            this->powers[t]++;
+        }
+    }
 
 private:
-    FunctionTreeVector<D> prod_vec;
+    double coef{1.0};                     // product of all numerical coefficients
+    std::vector<FunctionTree<D> *> trees; // distinct input trees
+    std::vector<int> powers;              // number of times each tree appears in the product
+    std::vector<Eigen::VectorXd> values;  // per-thread scratch for the input values
 
     void calcNode(MWNode<D> &node_o) override {
         const NodeIndex<D> &idx = node_o.getNodeIndex();
         double *coefs_o = node_o.getCoefs();
-        for (int j = 0; j < node_o.getNCoefs(); j++) { coefs_o[j] = 1.0; }
-        for (int i = 0; i < this->prod_vec.size(); i++) {
-            double c_i = get_coef(this->prod_vec, i);
-            FunctionTree<D> &func_i = get_func(this->prod_vec, i);
-            // This generates missing nodes
-            MWNode<D> node_i = func_i.getNode(idx); // Copy node
-            node_i.mwTransform(Reconstruction);
-            node_i.cvTransform(Forward);
-            const double *coefs_i = node_i.getCoefs();
-            int n_coefs = node_i.getNCoefs();
-            for (int j = 0; j < n_coefs; j++) { coefs_o[j] *= c_i * coefs_i[j]; }
+        int n_coefs = node_o.getNCoefs();
+        Eigen::VectorXd &vals = this->values[omp_get_thread_num()];
+        if (vals.size() != n_coefs) vals.resize(n_coefs);
+        for (int j = 0; j < n_coefs; j++) { coefs_o[j] = this->coef; }
+        for (int t = 0; t < this->trees.size(); t++) {
+            this->trees[t]->getNodeValues(idx, vals.data());
+            for (int p = 0; p < this->powers[t]; p++) {
+                for (int j = 0; j < n_coefs; j++) { coefs_o[j] *= vals(j); }
+            }
         }
         node_o.cvTransform(Backward);
         node_o.mwTransform(Compression);
@@ -25,7 +25,12 @@
 
 #pragma once
 
+#include <vector>
+
+#include <Eigen/Core>
+
 #include "TreeCalculator.h"
+#include "utils/omp_utils.h"
 
 namespace mrcpp {
 
@@ -33,22 +38,22 @@ template <int D> class PowerCalculator final : public TreeCalculator<D> {
 public:
     PowerCalculator(FunctionTree<D> &inp, double pow)
             : power(pow)
-            , func(&inp) {}
+            , func(&inp)
+            , values(omp_get_max_threads()) {}
 
 private:
     double power;
     FunctionTree<D> *func;
+    std::vector<Eigen::VectorXd> values; // per-thread scratch for the input values
 
     void calcNode(MWNode<D> &node_o) override {
         const NodeIndex<D> &idx = node_o.getNodeIndex();
         int n_coefs = node_o.getNCoefs();
         double *coefs_o = node_o.getCoefs();
-        // This generates missing nodes
-        MWNode<D> node_i = func->getNode(idx); // Copy node
-        node_i.mwTransform(Reconstruction);
-        node_i.cvTransform(Forward);
-        const double *coefs_i = node_i.getCoefs();
-        for (int j = 0; j < n_coefs; j++) { coefs_o[j] = std::pow(coefs_i[j], this->power); }
+        Eigen::VectorXd &vals = this->values[omp_get_thread_num()];
+        if (vals.size() != n_coefs) vals.resize(n_coefs);
+        func->getNodeValues(idx, vals.data());
+        for (int j = 0; j < n_coefs; j++) { coefs_o[j] = std::pow(vals(j), this->power); }
         node_o.cvTransform(Backward);
         node_o.mwTransform(Compression);
         node_o.setHasCoefs();
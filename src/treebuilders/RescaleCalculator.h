@@ -0,0 +1,54 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#pragma once
+
+#include "TreeCalculator.h"
+
+namespace mrcpp {
+
+/** Copy of an existing tree, with all coefficients multiplied by a constant.
+ * Coefficients are read with getNodeCoefs, so nodes that are missing in the
+ * input are filled from its end nodes, and the input is never modified. */
+template <int D> class RescaleCalculator final : public TreeCalculator<D> {
+public:
+    RescaleCalculator(double c, const MWTree<D> &inp)
+            : coef(c)
+            , tree(&inp) {}
+
+private:
+    double coef;
+    const MWTree<D> *tree;
+
+    void calcNode(MWNode<D> &node_o) override {
+        double *coefs_o = node_o.getCoefs();
+        this->tree->getNodeCoefs(node_o.getNodeIndex(), coefs_o);
+        for (int j = 0; j < node_o.getNCoefs(); j++) { coefs_o[j] *= this->coef; }
+        node_o.setHasCoefs();
+        node_o.calcNorms();
+    }
+};
+
+} // namespace mrcpp
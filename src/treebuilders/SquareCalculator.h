@@ -25,28 +25,33 @@
 
 #pragma once
 
+#include <vector>
+
+#include <Eigen/Core>
+
 #include "TreeCalculator.h"
+#include "utils/omp_utils.h"
 
 namespace mrcpp {
 
 template <int D> class SquareCalculator final : public TreeCalculator<D> {
 public:
     SquareCalculator(FunctionTree<D> &inp)
-            : func(&inp) {}
+            : func(&inp)
+            , values(omp_get_max_threads()) {}
 
 private:
     FunctionTree<D> *func;
+    std::vector<Eigen::VectorXd> values; // per-thread scratch for the input values
 
     void calcNode(MWNode<D> &node_o) override {
         const NodeIndex<D> &idx = node_o.getNodeIndex();
         int n_coefs = node_o.getNCoefs();
         double *coefs_o = node_o.getCoefs();
-        // This generates missing nodes
-        MWNode<D> node_i = func->getNode(idx); // Copy node
-        node_i.mwTransform(Reconstruction);
-        node_i.cvTransform(Forward);
-        const double *coefs_i = node_i.getCoefs();
-        for (int j = 0; j < n_coefs; j++) { coefs_o[j] = coefs_i[j] * coefs_i[j]; }
+        Eigen::VectorXd &vals = this->values[omp_get_thread_num()];
+        if (vals.size() != n_coefs) vals.resize(n_coefs);
+        func->getNodeValues(idx, vals.data());
+        for (int j = 0; j < n_coefs; j++) { coefs_o[j] = vals(j) * vals(j); }
         node_o.cvTransform(Backward);
         node_o.mwTransform(Compression);
         node_o.setHasCoefs();
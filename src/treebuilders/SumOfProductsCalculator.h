@@ -0,0 +1,119 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "TreeCalculator.h"
+#include "trees/FunctionTreeVector.h"
+#include "utils/omp_utils.h"
+
+namespace mrcpp {
+
+/** Calculator for a sum of products, out = sum_k c_k prod_i f_ki, where each
+ * term is given as a FunctionTreeVector (coefficients and factors). Product
+ * terms are evaluated in value space, with each distinct input tree
+ * transformed only once per node, and single factor terms are added directly
+ * to the compressed output coefs, as in the AdditionCalculator. */
+template <int D> class SumOfProductsCalculator final : public TreeCalculator<D> {
+public:
+    SumOfProductsCalculator(const std::vector<FunctionTreeVector<D>> &inp)
+            : values(omp_get_max_threads()) {
+        for (const auto &term : inp) {
+            if (term.size() == 0) continue;
+            if (term.size() == 1) {
+                this->sum_vec.push_back(term[0]);
+                continue;
+            }
+            double c_k = 1.0;
+            std::vector<int> factors;
+            for (int i = 0; i < term.size(); i++) {
+                c_k *= get_coef(term, i);
+                factors.push_back(getTreeIndex(std::get<1>(term[i])));
+            }
+            this->prod_coefs.push_back(c_k);
+            this->prod_factors.push_back(factors);
+        }
+    }
+
+private:
+    FunctionTreeVector<D> sum_vec;                // single factor terms
+    std::vector<FunctionTree<D> *> prod_trees;    // distinct factors of the product terms
+    std::vector<double> prod_coefs;               // coefficient of each product term
+    std::vector<std::vector<int>> prod_factors;   // factors of each product term, index into prod_trees
+    std::vector<Eigen::VectorXd> values;          // per-thread scratch for the factor values and products
+
+    int getTreeIndex(FunctionTree<D> *tree) {
+        for (int t = 0; t < this->prod_trees.size(); t++) {
+            if (this->prod_trees[t] == tree) return t;
+        }
+        this->prod_trees.push_back(tree);
+        return this->prod_trees.size() - 1;
+    }
+
+    void calcNode(MWNode<D> &node_o) override {
+        const NodeIndex<D> &idx = node_o.getNodeIndex();
+        double *coefs_o = node_o.getCoefs();
+        int n_coefs = node_o.getNCoefs();
+        node_o.zeroCoefs();
+
+        // function values of each distinct factor on the node, followed by the
+        // product (or the coefs of a single factor term)
+        int n_trees = this->prod_trees.size();
+        Eigen::VectorXd &vals = this->values[omp_get_thread_num()];
+        if (vals.size() != (n_trees + 1) * n_coefs) vals.resize((n_trees + 1) * n_coefs);
+        double *prod = vals.data() + n_trees * n_coefs;
+
+        if (this->prod_coefs.size() > 0) {
+            for (int t = 0; t < n_trees; t++) {
+                this->prod_trees[t]->getNodeValues(idx, vals.data() + t * n_coefs);
+            }
+            for (int k = 0; k < this->prod_coefs.size(); k++) {
+                for (int j = 0; j < n_coefs; j++) { prod[j] = this->prod_coefs[k]; }
+                for (int t : this->prod_factors[k]) {
+                    const double *values_t = vals.data() + t * n_coefs;
+                    for (int j = 0; j < n_coefs; j++) { prod[j] *= values_t[j]; }
+                }
+                for (int j = 0; j < n_coefs; j++) { coefs_o[j] += prod[j]; }
+            }
+            node_o.cvTransform(Backward);
+            node_o.mwTransform(Compression);
+        }
+
+        for (int i = 0; i < this->sum_vec.size(); i++) {
+            double c_i = get_coef(this->sum_vec, i);
+            FunctionTree<D> &func_i = get_func(this->sum_vec, i);
+            func_i.getNodeCoefs(idx, prod);
+            for (int j = 0; j < n_coefs; j++) { coefs_o[j] += c_i * prod[j]; }
+        }
+        node_o.setHasCoefs();
+        node_o.calcNorms();
+    }
+};
+
+} // namespace mrcpp
@@ -25,8 +25,11 @@
 
 #pragma once
 
+#include <vector>
+
 #include "MRCPP/mrcpp_declarations.h"
 #include "trees/MWNode.h"
+#include "trees/MWTree.h"
 
 namespace mrcpp {
 
@@ -38,16 +41,31 @@ public:
 
     void setMaxScale(int ms) { this->maxScale = ms; }
 
+    /** Split decision for a single node, without creating any children */
+    bool checkSplit(const MWNode<D> &node) const {
+        // Can be BranchNode in operator application
+        if (node.isBranchNode()) return false;
+        if (node.getScale() + 2 > this->maxScale) return false;
+        return splitNode(node);
+    }
+
+    /** Split decisions are made in parallel, after which the children of all
+     * nodes to be split are created together. The output vector keeps the
+     * order of the input, independent of the number of threads. */
     void splitNodeVector(MWNodeVector<D> &out, MWNodeVector<D> &inp) const {
-        for (int n = 0; n < inp.size(); n++) {
-            MWNode<D> &node = *inp[n];
-            // Can be BranchNode in operator application
-            if (node.isBranchNode()) continue;
-            if (node.getScale() + 2 > this->maxScale) continue;
-            if (splitNode(node)) {
-                node.createChildren();
-                for (int i = 0; i < node.getNChildren(); i++) { out.push_back(&node.getMWChild(i)); }
-            }
+        int nNodes = inp.size();
+        std::vector<char> split(nNodes, 0);
+#pragma omp parallel for schedule(guided) if (nNodes > 64)
+        for (int n = 0; n < nNodes; n++) split[n] = checkSplit(*inp[n]);
+
+        MWNodeVector<D> parents;
+        for (int n = 0; n < nNodes; n++) {
+            if (split[n]) parents.push_back(inp[n]);
+        }
+        if (parents.size() == 0) return;
+        parents[0]->getMWTree().createChildren(parents);
+        for (auto *node : parents) {
+            for (int i = 0; i < node->getNChildren(); i++) { out.push_back(&node->getMWChild(i)); }
         }
     }
 
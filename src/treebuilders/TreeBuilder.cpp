@@ -30,16 +30,76 @@
 #include "trees/MWTree.h"
 #include "utils/Printer.h"
 #include "utils/Timer.h"
+#include "utils/omp_utils.h"
 
 namespace mrcpp {
 
+static BuildEngine build_engine = BuildEngine::Levels;
+
+/** Select the engine used by all subsequent calls to TreeBuilder::build */
+void set_build_engine(BuildEngine engine) {
+    build_engine = engine;
+}
+
+BuildEngine get_build_engine() {
+    return build_engine;
+}
+
 template <int D>
 void TreeBuilder<D>::build(MWTree<D> &tree, TreeCalculator<D> &calculator, TreeAdaptor<D> &adaptor, int maxIter) const {
-    Timer calc_t(false), split_t(false), norm_t(false);
+    if (build_engine == BuildEngine::Tasks) {
+        buildTasks(tree, calculator, adaptor, maxIter);
+    } else {
+        buildLevels(tree, calculator, adaptor, maxIter);
+    }
+}
+
+/** Level-synchronous build: the whole work vector is computed, the norm is
+ * updated, and all nodes are split before the next level is started. */
+template <int D>
+void TreeBuilder<D>::buildLevels(MWTree<D> &tree,
+                                 TreeCalculator<D> &calculator,
+                                 TreeAdaptor<D> &adaptor,
+                                 int maxIter) const {
     println(10, " == Building tree");
+    MWNodeVector<D> *workVec = calculator.getInitialWorkVector(tree);
+    refineLevels(tree, calculator, adaptor, workVec, 0.0, maxIter);
+}
 
+/** Partial rebuild of an existing tree: only the given EndNodes are computed
+ * and refined, level by level, while the rest of the tree is left untouched.
+ * restNorm is the squared norm of the part of the tree that is not covered by
+ * the nodes. The norm estimate for relative precision is restNorm plus the
+ * norms computed for the nodes, so that the refinement matches the one of a
+ * full build. */
+template <int D>
+void TreeBuilder<D>::rebuild(MWTree<D> &tree,
+                             TreeCalculator<D> &calculator,
+                             TreeAdaptor<D> &adaptor,
+                             const MWNodeVector<D> &nodes,
+                             double restNorm,
+                             int maxIter) const {
+    for (auto *node : nodes) {
+        if (not node->isEndNode()) MSG_ABORT("Only EndNodes can be rebuilt");
+    }
+    println(10, " == Rebuilding tree");
+    auto *workVec = new MWNodeVector<D>(nodes);
+    refineLevels(tree, calculator, adaptor, workVec, (restNorm > 0.0) ? restNorm : 0.0, maxIter);
+}
+
+/** Compute and refine the nodes of workVec (which is deleted) until the grid
+ * is converged. The norm estimate for relative precision is restNorm (the
+ * squared norm of the rest of the tree) plus the scaling norm of the initial
+ * nodes plus the wavelet norms computed so far. */
+template <int D>
+void TreeBuilder<D>::refineLevels(MWTree<D> &tree,
+                                  TreeCalculator<D> &calculator,
+                                  TreeAdaptor<D> &adaptor,
+                                  MWNodeVector<D> *workVec,
+                                  double restNorm,
+                                  int maxIter) const {
+    Timer calc_t(false), split_t(false), norm_t(false);
     MWNodeVector<D> *newVec = nullptr;
-    MWNodeVector<D> *workVec = calculator.getInitialWorkVector(tree);
 
     double sNorm = 0.0;
     double wNorm = 0.0;
@@ -53,7 +113,10 @@ void TreeBuilder<D>::build(MWTree<D> &tree, TreeCalculator<D> &calculator, TreeA
         calc_t.stop();
 
         norm_t.resume();
-        if (iter == 0) { sNorm = calcScalingNorm(*workVec); }
+        if (iter == 0) {
+            sNorm = calcScalingNorm(*workVec);
+            if (sNorm >= 0.0) sNorm += restNorm;
+        }
         wNorm += calcWaveletNorm(*workVec);
 
         if (sNorm < 0.0 or wNorm < 0.0) {
@@ -85,6 +148,101 @@ void TreeBuilder<D>::build(MWTree<D> &tree, TreeCalculator<D> &calculator, TreeA
     print::time(10, "Time split", split_t);
 }
 
+/** Task-based build: the initial work vector is computed in one parallel
+ * loop, after which each node that is split spawns one task per child, which
+ * is computed and split in turn. There are no barriers between levels. The
+ * tree norm used for relative thresholding is a running estimate (scaling
+ * norm of the initial nodes plus the wavelet norms computed so far), which
+ * is never larger than the one of the level-synchronous build, so the grid is
+ * at least as refined. The grid may depend slightly on the task execution
+ * order when relative precision is used. */
+template <int D>
+void TreeBuilder<D>::buildTasks(MWTree<D> &tree,
+                                TreeCalculator<D> &calculator,
+                                TreeAdaptor<D> &adaptor,
+                                int maxIter) const {
+    Timer calc_t(false), build_t(false);
+    println(10, " == Building tree (tasks)");
+
+    MWNodeVector<D> *workVec = calculator.getInitialWorkVector(tree);
+    int nNodes = workVec->size();
+
+    calc_t.resume();
+#pragma omp parallel for schedule(guided)
+    for (int n = 0; n < nNodes; n++) calculator.calcNode(*(*workVec)[n]);
+    calc_t.stop();
+
+    double sNorm = calcScalingNorm(*workVec);
+    double wNorm = calcWaveletNorm(*workVec);
+    bool validNorm = (sNorm >= 0.0 and wNorm >= 0.0);
+    tree.squareNorm = (validNorm) ? sNorm + wNorm : -1.0;
+
+    // tree.squareNorm is kept up to date by the tasks only when it is valid,
+    // otherwise the node wavelet norms are collected in wNorm and discarded
+    double &runningNorm = (validNorm) ? tree.squareNorm : wNorm;
+
+    build_t.resume();
+    if (maxIter != 0) {
+        MWTree<D> *tree_p = &tree;
+        TreeCalculator<D> *calc_p = &calculator;
+        TreeAdaptor<D> *adap_p = &adaptor;
+        double *norm_p = &runningNorm;
+#pragma omp parallel firstprivate(nNodes, maxIter, tree_p, calc_p, adap_p, norm_p) shared(workVec)
+        {
+#pragma omp single
+            for (int n = 0; n < nNodes; n++) {
+                MWNode<D> *node_p = (*workVec)[n];
+#pragma omp task firstprivate(node_p)
+                refineTask(*node_p, *calc_p, *adap_p, 0, maxIter, *norm_p);
+            }
+        }
+    }
+    build_t.stop();
+    calculator.postProcess();
+
+    tree.resetEndNodeTable();
+    delete workVec;
+
+    println(10, "  -- Built " << std::setw(6) << tree.getNNodes() << " nodes " << std::setw(24) << tree.squareNorm);
+    print::separator(10, ' ');
+    print::time(10, "Time calc", calc_t);
+    print::time(10, "Time build", build_t);
+}
+
+/** Split node (computed at iteration iter) and compute and refine each of its
+ * children in a separate task. Node allocation is not thread safe and is done
+ * in a critical section. */
+template <int D>
+void TreeBuilder<D>::refineTask(MWNode<D> &node,
+                                TreeCalculator<D> &calculator,
+                                const TreeAdaptor<D> &adaptor,
+                                int iter,
+                                int maxIter,
+                                double &wNorm) const {
+    if (iter >= maxIter and maxIter >= 0) return;
+    if (not adaptor.checkSplit(node)) return;
+
+#pragma omp critical(tree_builder_alloc)
+    node.createChildren();
+
+    TreeCalculator<D> *calc_p = &calculator;
+    const TreeAdaptor<D> *adap_p = &adaptor;
+    double *norm_p = &wNorm;
+    for (int i = 0; i < node.getNChildren(); i++) {
+        MWNode<D> *child_p = &node.getMWChild(i);
+#pragma omp task firstprivate(child_p, calc_p, adap_p, norm_p, iter, maxIter)
+        {
+            calc_p->calcNode(*child_p);
+            double w = child_p->getWaveletNorm();
+            if (w > 0.0) {
+#pragma omp atomic
+                *norm_p += w;
+            }
+            refineTask(*child_p, *calc_p, *adap_p, iter + 1, maxIter, *norm_p);
+        }
+    }
+}
+
 template <int D> void TreeBuilder<D>::clear(MWTree<D> &tree, TreeCalculator<D> &calculator) const {
     println(10, " == Clearing tree");
 
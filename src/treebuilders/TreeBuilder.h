@@ -29,9 +29,25 @@
 
 namespace mrcpp {
 
+/** Engine used by TreeBuilder::build. Levels refines one scale at a time, with
+ * a barrier between levels. Tasks computes the children of a node as soon as
+ * it has been split, using OpenMP tasks and a running estimate of the norm. */
+enum class BuildEngine { Levels, Tasks };
+
+void set_build_engine(BuildEngine engine);
+BuildEngine get_build_engine();
+
 template <int D> class TreeBuilder final {
 public:
     void build(MWTree<D> &tree, TreeCalculator<D> &calculator, TreeAdaptor<D> &adaptor, int maxIter) const;
+    void buildLevels(MWTree<D> &tree, TreeCalculator<D> &calculator, TreeAdaptor<D> &adaptor, int maxIter) const;
+    void buildTasks(MWTree<D> &tree, TreeCalculator<D> &calculator, TreeAdaptor<D> &adaptor, int maxIter) const;
+    void rebuild(MWTree<D> &tree,
+                 TreeCalculator<D> &calculator,
+                 TreeAdaptor<D> &adaptor,
+                 const MWNodeVector<D> &nodes,
+                 double restNorm,
+                 int maxIter) const;
     void clear(MWTree<D> &tree, TreeCalculator<D> &calculator) const;
     void calc(MWTree<D> &tree, TreeCalculator<D> &calculator) const;
     int split(MWTree<D> &tree, TreeAdaptor<D> &adaptor, bool passCoefs) const;
@@ -39,6 +55,20 @@ public:
 private:
     double calcScalingNorm(const MWNodeVector<D> &vec) const;
     double calcWaveletNorm(const MWNodeVector<D> &vec) const;
+
+    void refineLevels(MWTree<D> &tree,
+                      TreeCalculator<D> &calculator,
+                      TreeAdaptor<D> &adaptor,
+                      MWNodeVector<D> *workVec,
+                      double restNorm,
+                      int maxIter) const;
+
+    void refineTask(MWNode<D> &node,
+                    TreeCalculator<D> &calculator,
+                    const TreeAdaptor<D> &adaptor,
+                    int iter,
+                    int maxIter,
+                    double &wNorm) const;
 };
 
 } // namespace mrcpp
@@ -50,6 +50,8 @@ public:
     }
 
 protected:
+    friend class TreeBuilder<D>;
+
     virtual void calcNode(MWNode<D> &node) = 0;
     virtual void postProcess() {}
 };
@@ -101,6 +101,7 @@ void add(double prec,
 template <int D> void add(double prec, FunctionTree<D> &out, FunctionTreeVector<D> &inp, int maxIter, bool absPrec) {
     for (auto i = 0; i < inp.size(); i++)
         if (out.getMRA() != get_func(inp, i).getMRA()) MSG_ABORT("Incompatible MRA");
+    if (out.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     int maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
@@ -114,15 +115,7 @@ template <int D> void add(double prec, FunctionTree<D> &out, FunctionTreeVector<
     out.calcSquareNorm();
     trans_t.stop();
 
-    Timer clean_t;
-    for (int i = 0; i < inp.size(); i++) {
-        FunctionTree<D> &tree = get_func(inp, i);
-        tree.deleteGenerated();
-    }
-    clean_t.stop();
-
     print::time(10, "Time transform", trans_t);
-    print::time(10, "Time cleaning", clean_t);
     print::separator(10, ' ');
 }
 
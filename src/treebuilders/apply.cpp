@@ -70,9 +70,16 @@ void apply(double prec,
            int maxIter,
            bool absPrec) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
+    if (inp.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
+
+    // Input nodes are looked up through a hash table for the duration of the
+    // application, unless the caller already set one up
+    bool tmpTable = (not inp.hasNodeHashTable());
+    if (tmpTable) inp.makeNodeHashTable();
 
     Timer pre_t;
     oper.calcBandWidths(prec);
+    oper.calcReducedTerms(prec, D);
     int maxScale = out.getMRA().getMaxScale();
     WaveletAdaptor<D> adaptor(prec, maxScale, absPrec);
     ConvolutionCalculator<D> calculator(prec, oper, inp);
@@ -83,10 +90,12 @@ void apply(double prec,
 
     Timer post_t;
     oper.clearBandWidths();
+    oper.clearReducedTerms();
     out.mwTransform(TopDown, false); // add coarse scale contributions
     out.mwTransform(BottomUp);
     out.calcSquareNorm();
     inp.deleteGenerated();
+    if (tmpTable) inp.deleteNodeHashTable();
     post_t.stop();
 
     print::time(10, "Time pre operator", pre_t);
@@ -112,6 +121,7 @@ void apply(double prec,
  */
 template <int D> void apply(FunctionTree<D> &out, DerivativeOperator<D> &oper, FunctionTree<D> &inp, int dir) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
+    if (inp.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     TreeBuilder<D> builder;
     int maxScale = out.getMRA().getMaxScale();
@@ -119,6 +129,10 @@ template <int D> void apply(FunctionTree<D> &out, DerivativeOperator<D> &oper, F
     int bw[D]; // Operator bandwidth in [x,y,z]
     for (int d = 0; d < D; d++) bw[d] = 0;
 
+    // Input nodes are looked up through a hash table, see convolution apply
+    bool tmpTable = (not inp.hasNodeHashTable());
+    if (tmpTable) inp.makeNodeHashTable();
+
     // Copy input tree plus bandwidth in operator direction
     Timer pre_t;
     oper.calcBandWidths(1.0); // Fixed 0 or 1 for derivatives
@@ -138,6 +152,7 @@ template <int D> void apply(FunctionTree<D> &out, DerivativeOperator<D> &oper, F
     out.mwTransform(BottomUp);
     out.calcSquareNorm();
     inp.deleteGenerated();
+    if (tmpTable) inp.deleteNodeHashTable();
     post_t.stop();
 
     print::time(10, "Time pre operator", pre_t);
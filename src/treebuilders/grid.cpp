@@ -33,6 +33,7 @@
 #include "add.h"
 #include "functions/GaussExp.h"
 #include "functions/function_utils.h"
+#include "trees/SerialFunctionTree.h"
 #include "utils/Printer.h"
 
 namespace mrcpp {
@@ -144,11 +145,17 @@ template <int D> void build_grid(FunctionTree<D> &out, const GaussExp<D> &inp, i
  */
 template <int D> void build_grid(FunctionTree<D> &out, FunctionTree<D> &inp, int maxIter) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
+    // Input nodes are looked up through a hash table during the build, the
+    // output is refined concurrently and can not use one
+    bool tmpTable = (&out != &inp and not inp.hasNodeHashTable());
+    if (tmpTable) inp.makeNodeHashTable();
+
     auto maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
     CopyAdaptor<D> adaptor(inp, maxScale, nullptr);
     DefaultCalculator<D> calculator;
     builder.build(out, calculator, adaptor, maxIter);
+    if (tmpTable) inp.deleteNodeHashTable();
     print::separator(10, ' ');
 }
 
@@ -175,11 +182,21 @@ template <int D> void build_grid(FunctionTree<D> &out, FunctionTreeVector<D> &in
     for (auto i = 0; i < inp.size(); i++)
         if (out.getMRA() != get_func(inp, i).getMRA()) MSG_ABORT("Incompatible MRA");
 
+    // Input nodes are looked up through hash tables, see build_grid above
+    std::vector<FunctionTree<D> *> tmpTables;
+    for (auto i = 0; i < inp.size(); i++) {
+        FunctionTree<D> &func_i = get_func(inp, i);
+        if (&func_i == &out or func_i.hasNodeHashTable()) continue;
+        func_i.makeNodeHashTable();
+        tmpTables.push_back(&func_i);
+    }
+
     auto maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
     CopyAdaptor<D> adaptor(inp, maxScale, nullptr);
     DefaultCalculator<D> calculator;
     builder.build(out, calculator, adaptor, maxIter);
+    for (auto *func_i : tmpTables) func_i->deleteNodeHashTable();
     print::separator(10, ' ');
 }
 
@@ -194,9 +211,16 @@ template <int D> void build_grid(FunctionTree<D> &out, FunctionTreeVector<D> &in
  *
  * @note This algorithm will start at whatever grid is present in the `out`
  * tree when the function is called and will overwrite any existing coefs.
+ * If the grids are identical (e.g. after `copy_grid`), the coefficients are
+ * simply copied node by node.
  *
  */
 template <int D> void copy_func(FunctionTree<D> &out, FunctionTree<D> &inp) {
+    if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA")
+    // identical grids, e.g. from copy_grid: plain copy of the coefficients
+    out.deleteGenerated();
+    if (out.getSerialFunctionTree()->copyCoefs(*inp.getSerialFunctionTree())) return;
+
     FunctionTreeVector<D> tmp_vec;
     tmp_vec.push_back(std::make_tuple(1.0, &inp));
     add(-1.0, out, tmp_vec);
@@ -211,11 +235,20 @@ template <int D> void copy_func(FunctionTree<D> &out, FunctionTree<D> &inp) {
  * this will first clear the grid of the `out` function, while `build_grid`
  * will _extend_ the existing grid.
  *
+ * @details The packed node topology of the input is unpacked directly into
+ * the output, reusing its memory chunks, so no tree building is involved.
+ *
  */
 template <int D> void copy_grid(FunctionTree<D> &out, FunctionTree<D> &inp) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA")
     out.clear();
-    build_grid(out, inp);
+    SerialFunctionTree<D> &sOut = *out.getSerialFunctionTree();
+    if (sOut.isShared() or sOut.isSinglePrecision() or &out == &inp) {
+        build_grid(out, inp);
+    } else {
+        // the node topology is copied directly, no tree building
+        sOut.copyTopology(*inp.getSerialFunctionTree());
+    }
 }
 
 /** @brief Clear the MW coefficients of a function representation
@@ -290,10 +323,15 @@ template <int D> int refine_grid(FunctionTree<D> &out, double prec, bool absPrec
  */
 template <int D> int refine_grid(FunctionTree<D> &out, FunctionTree<D> &inp) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA")
+    // Input nodes are looked up through a hash table, see build_grid
+    bool tmpTable = (&out != &inp and not inp.hasNodeHashTable());
+    if (tmpTable) inp.makeNodeHashTable();
+
     auto maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
     CopyAdaptor<D> adaptor(inp, maxScale, nullptr);
     auto nSplit = builder.split(out, adaptor, true);
+    if (tmpTable) inp.deleteNodeHashTable();
     return nSplit;
 }
 
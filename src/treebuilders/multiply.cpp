@@ -27,17 +27,20 @@
 #include "MultiplicationCalculator.h"
 #include "PowerCalculator.h"
 #include "SquareCalculator.h"
+#include "SumOfProductsCalculator.h"
 #include "TreeBuilder.h"
 #include "WaveletAdaptor.h"
 #include "add.h"
 #include "grid.h"
 #include "trees/FunctionNode.h"
 #include "trees/FunctionTree.h"
-#include "trees/HilbertIterator.h"
+#include "trees/HilbertPath.h"
 #include "trees/SerialFunctionTree.h"
 #include "utils/Printer.h"
 #include "utils/Timer.h"
 #include <Eigen/Core>
+#include <algorithm>
+#include <vector>
 
 namespace mrcpp {
 
@@ -104,6 +107,7 @@ template <int D>
 void multiply(double prec, FunctionTree<D> &out, FunctionTreeVector<D> &inp, int maxIter, bool absPrec) {
     for (auto i = 0; i < inp.size(); i++)
         if (out.getMRA() != get_func(inp, i).getMRA()) MSG_ABORT("Incompatible MRA");
+    if (out.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     int maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
@@ -117,15 +121,59 @@ void multiply(double prec, FunctionTree<D> &out, FunctionTreeVector<D> &inp, int
     out.calcSquareNorm();
     trans_t.stop();
 
-    Timer clean_t;
-    for (int i = 0; i < inp.size(); i++) {
-        FunctionTree<D> &tree = get_func(inp, i);
-        tree.deleteGenerated();
+    print::time(10, "Time transform", trans_t);
+    print::separator(10, ' ');
+}
+
+/** @brief Sum of products of MW function representations, adaptive grid
+ *
+ * @param[in] prec: Build precision of output function
+ * @param[out] out: Output function to be built
+ * @param[in] inp: Terms of the sum, each given as a vector of factors
+ * @param[in] maxIter: Maximum number of refinement iterations in output tree
+ * @param[in] absPrec: Build output tree based on absolute precision
+ *
+ * @details The output function will be computed as the sum over the terms of
+ * the product of all functions in each term (including their numerical
+ * coefficients), e.g. `a*f*g + b*h` is given as the two terms `{(a, f), (1, g)}`
+ * and `{(b, h)}`. The whole expression is evaluated node by node in a single
+ * adaptive build, without intermediate trees, using the general algorithm:
+ * - Compute MW coefs on current grid
+ * - Refine grid where necessary based on `prec`
+ * - Repeat until convergence or `maxIter` is reached
+ * - `prec < 0` or `maxIter = 0` means NO refinement
+ * - `maxIter < 0` means no bound
+ *
+ * @note This algorithm will start at whatever grid is present in the `out`
+ * tree when the function is called (this grid should however be EMPTY, e.i.
+ * no coefs).
+ *
+ */
+template <int D>
+void sum_of_products(double prec,
+                     FunctionTree<D> &out,
+                     std::vector<FunctionTreeVector<D>> &inp,
+                     int maxIter,
+                     bool absPrec) {
+    for (auto &term : inp) {
+        for (auto i = 0; i < term.size(); i++)
+            if (out.getMRA() != get_func(term, i).getMRA()) MSG_ABORT("Incompatible MRA");
     }
-    clean_t.stop();
+    if (out.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
+
+    int maxScale = out.getMRA().getMaxScale();
+    TreeBuilder<D> builder;
+    WaveletAdaptor<D> adaptor(prec, maxScale, absPrec);
+    SumOfProductsCalculator<D> calculator(inp);
+
+    builder.build(out, calculator, adaptor, maxIter);
+
+    Timer trans_t;
+    out.mwTransform(BottomUp);
+    out.calcSquareNorm();
+    trans_t.stop();
 
     print::time(10, "Time transform", trans_t);
-    print::time(10, "Time cleaning", clean_t);
     print::separator(10, ' ');
 }
 
@@ -152,6 +200,7 @@ void multiply(double prec, FunctionTree<D> &out, FunctionTreeVector<D> &inp, int
  */
 template <int D> void square(double prec, FunctionTree<D> &out, FunctionTree<D> &inp, int maxIter, bool absPrec) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
+    if (out.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     int maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
@@ -165,12 +214,7 @@ template <int D> void square(double prec, FunctionTree<D> &out, FunctionTree<D>
     out.calcSquareNorm();
     trans_t.stop();
 
-    Timer clean_t;
-    inp.deleteGenerated();
-    clean_t.stop();
-
     print::time(10, "Time transform", trans_t);
-    print::time(10, "Time cleaning", clean_t);
     print::separator(10, ' ');
 }
 
@@ -199,6 +243,7 @@ template <int D> void square(double prec, FunctionTree<D> &out, FunctionTree<D>
 template <int D>
 void power(double prec, FunctionTree<D> &out, FunctionTree<D> &inp, double p, int maxIter, bool absPrec) {
     if (out.getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
+    if (out.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     int maxScale = out.getMRA().getMaxScale();
     TreeBuilder<D> builder;
@@ -212,12 +257,7 @@ void power(double prec, FunctionTree<D> &out, FunctionTree<D> &inp, double p, in
     out.calcSquareNorm();
     trans_t.stop();
 
-    Timer clean_t;
-    inp.deleteGenerated();
-    clean_t.stop();
-
     print::time(10, "Time transform", trans_t);
-    print::time(10, "Time cleaning", clean_t);
     print::separator(10, ' ');
 }
 
@@ -263,6 +303,24 @@ void dot(double prec,
     clear(tmp_vec, true);
 }
 
+/** Collect the pairs of bra and ket nodes with the same NodeIndex by walking
+ * the two trees together, in Hilbert order of the bra tree. GenNodes are
+ * never returned, and the ket side stops at its end nodes. */
+template <int D>
+static void match_nodes(const MWNode<D> &bra,
+                        const MWNode<D> &ket,
+                        std::vector<const MWNode<D> *> &braVec,
+                        std::vector<const MWNode<D> *> &ketVec) {
+    braVec.push_back(&bra);
+    ketVec.push_back(&ket);
+    if (bra.isEndNode() or ket.isEndNode()) return;
+    const HilbertPath<D> &h = bra.getHilbertPath();
+    for (int i = 0; i < bra.getTDim(); i++) {
+        int cIdx = h.getZIndex(i);
+        match_nodes(bra.getMWChild(cIdx), ket.getMWChild(cIdx), braVec, ketVec);
+    }
+}
+
 /** @returns Dot product <bra|ket> of two MW function representations
  *
  * @param[in] bra: Bra side input function
@@ -275,42 +333,204 @@ void dot(double prec,
  * efficient procedure as you only need to compute the dot product where the
  * grids overlap.
  *
+ * The node contributions are summed in parallel over fixed blocks of the
+ * Hilbert ordered node list, and the block sums are added in order, so the
+ * result is bitwise identical for any number of threads.
+ *
  */
 template <int D> double dot(FunctionTree<D> &bra, FunctionTree<D> &ket) {
     if (bra.getMRA() != ket.getMRA()) MSG_ABORT("Trees not compatible");
+    if (bra.isSinglePrecision() or ket.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
-    MWNodeVector<D> nodeTable;
-    HilbertIterator<D> it(&bra);
-    it.setReturnGenNodes(false);
-    while (it.next()) {
-        MWNode<D> &node = it.getNode();
-        nodeTable.push_back(&node);
+    std::vector<const MWNode<D> *> braVec;
+    std::vector<const MWNode<D> *> ketVec;
+    for (int rIdx = 0; rIdx < bra.getRootBox().size(); rIdx++) {
+        match_nodes(bra.getRootMWNode(rIdx), ket.getRootMWNode(rIdx), braVec, ketVec);
     }
-    int nNodes = nodeTable.size();
-    double result = 0.0;
-    double locResult = 0.0;
-    // OMP is disabled in order to get EXACT results (to the very last digit), the
-    // order of summation makes the result different beyond the 14th digit or so.
-    // OMP does improve the performace, but its not worth it for the time being.
-    //#pragma omp parallel firstprivate(n_nodes, locResult)
-    //		shared(nodeTable,rhs,result)
-    //    {
-    //#pragma omp for schedule(guided)
-    for (int n = 0; n < nNodes; n++) {
-        const auto &braNode = static_cast<const FunctionNode<D> &>(*nodeTable[n]);
-        const MWNode<D> *mwNode = ket.findNode(braNode.getNodeIndex());
-        if (mwNode == nullptr) continue;
 
-        const auto &ketNode = static_cast<const FunctionNode<D> &>(*mwNode);
-        if (braNode.isRootNode()) { locResult += dotScaling(braNode, ketNode); }
-        locResult += dotWavelet(braNode, ketNode);
+    // the block size must not depend on the number of threads
+    const int blockSize = 64;
+    int nNodes = braVec.size();
+    int nBlocks = (nNodes + blockSize - 1) / blockSize;
+    std::vector<double> blockResult(nBlocks, 0.0);
+#pragma omp parallel for schedule(guided) if (nBlocks > 1)
+    for (int b = 0; b < nBlocks; b++) {
+        double locResult = 0.0;
+        int nLast = std::min(nNodes, (b + 1) * blockSize);
+        for (int n = b * blockSize; n < nLast; n++) {
+            const auto &braNode = static_cast<const FunctionNode<D> &>(*braVec[n]);
+            const auto &ketNode = static_cast<const FunctionNode<D> &>(*ketVec[n]);
+            if (braNode.isRootNode()) { locResult += dotScaling(braNode, ketNode); }
+            locResult += dotWavelet(braNode, ketNode);
+        }
+        blockResult[b] = locResult;
     }
-    //#pragma omp critical
-    result += locResult;
-    //    }
+    double result = 0.0;
+    for (int b = 0; b < nBlocks; b++) result += blockResult[b];
     return result;
 }
 
+/** Collect the nodes of the union grid of the trees by walking all of them
+ * together, depth first. Each union node is stored as the range
+ * [offsets[n], offsets[n+1]) of (tree index, node) entries for the trees that
+ * have the node. Trees with index below nBra are bra functions, the rest are
+ * ket functions. Descent stops where no bra or no ket tree is refined further
+ * (symmetric case: nBra = 0, every tree is both bra and ket). */
+template <int D>
+static void collect_union_nodes(const std::vector<std::pair<int, const MWNode<D> *>> &present,
+                                int nBra,
+                                std::vector<int> &offsets,
+                                std::vector<std::pair<int, const MWNode<D> *>> &entries) {
+    entries.insert(entries.end(), present.begin(), present.end());
+    offsets.push_back(entries.size());
+
+    std::vector<std::pair<int, const MWNode<D> *>> childPresent;
+    int tDim = present[0].second->getTDim();
+    for (int cIdx = 0; cIdx < tDim; cIdx++) {
+        childPresent.clear();
+        bool hasBra = false;
+        bool hasKet = false;
+        for (const auto &entry : present) {
+            if (entry.second->isEndNode()) continue;
+            childPresent.push_back(std::make_pair(entry.first, &entry.second->getMWChild(cIdx)));
+            if (entry.first < nBra) hasBra = true;
+            if (entry.first >= nBra) hasKet = true;
+        }
+        if (nBra == 0) hasBra = true;
+        if (hasBra and hasKet) collect_union_nodes(childPresent, nBra, offsets, entries);
+    }
+}
+
+/** Overlap matrix between the trees of bra and ket (or of bra with itself
+ * when ket is NULL), in one pass over the union grid. For each union node the
+ * coefficient vectors of the trees that have the node are gathered into dense
+ * panels, which are multiplied with a single matrix product. */
+template <int D> static Eigen::MatrixXd calc_overlap(FunctionTreeVector<D> &bra, FunctionTreeVector<D> *ket) {
+    bool symmetric = (ket == nullptr);
+    int nBra = bra.size();
+    int nKet = (symmetric) ? nBra : ket->size();
+    Eigen::MatrixXd S = Eigen::MatrixXd::Zero(nBra, nKet);
+    if (nBra == 0 or nKet == 0) return S;
+
+    // all trees are stored in one list, bra first
+    std::vector<FunctionTree<D> *> trees;
+    for (int i = 0; i < nBra; i++) trees.push_back(&get_func(bra, i));
+    for (int i = 0; i < nKet and not symmetric; i++) trees.push_back(&get_func(*ket, i));
+    for (auto *tree : trees) {
+        if (tree->getMRA() != trees[0]->getMRA()) MSG_ABORT("Trees not compatible");
+        if (tree->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
+    }
+
+    std::vector<int> offsets(1, 0);
+    std::vector<std::pair<int, const MWNode<D> *>> entries;
+    std::vector<std::pair<int, const MWNode<D> *>> present;
+    for (int rIdx = 0; rIdx < trees[0]->getRootBox().size(); rIdx++) {
+        present.clear();
+        for (int i = 0; i < trees.size(); i++) present.push_back(std::make_pair(i, &trees[i]->getRootMWNode(rIdx)));
+        collect_union_nodes(present, (symmetric) ? 0 : nBra, offsets, entries);
+    }
+
+    int nNodes = offsets.size() - 1;
+    int kp1_d = trees[0]->getKp1_d();
+    int tDim = trees[0]->getTDim();
+#pragma omp parallel shared(S, offsets, entries)
+    {
+        Eigen::MatrixXd locS = Eigen::MatrixXd::Zero(nBra, nKet);
+        Eigen::MatrixXd A, B, S_n;
+        std::vector<int> braIdx, ketIdx;
+#pragma omp for schedule(dynamic)
+        for (int n = 0; n < nNodes; n++) {
+            // scaling coefs contribute on root nodes only
+            const MWNode<D> &first = *entries[offsets[n]].second;
+            int start = (first.isRootNode()) ? 0 : kp1_d;
+            int nCoefs = tDim * kp1_d - start;
+
+            braIdx.clear();
+            ketIdx.clear();
+            for (int e = offsets[n]; e < offsets[n + 1]; e++) {
+                int i = entries[e].first;
+                if (symmetric or i < nBra) braIdx.push_back(e);
+                if (symmetric or i >= nBra) ketIdx.push_back(e);
+            }
+            if (braIdx.size() == 0 or ketIdx.size() == 0) continue;
+
+            A.resize(nCoefs, braIdx.size());
+            for (int b = 0; b < braIdx.size(); b++) {
+                const double *coefs = entries[braIdx[b]].second->getCoefs();
+                A.col(b) = Eigen::Map<const Eigen::VectorXd>(coefs + start, nCoefs);
+            }
+            if (symmetric) {
+                S_n.setZero(braIdx.size(), braIdx.size());
+                S_n.selfadjointView<Eigen::Lower>().rankUpdate(A.transpose());
+                for (int b = 0; b < braIdx.size(); b++) {
+                    int i = entries[braIdx[b]].first;
+                    for (int k = 0; k <= b; k++) {
+                        int j = entries[braIdx[k]].first;
+                        locS(i, j) += S_n(b, k);
+                        if (i != j) locS(j, i) += S_n(b, k);
+                    }
+                }
+            } else {
+                B.resize(nCoefs, ketIdx.size());
+                for (int k = 0; k < ketIdx.size(); k++) {
+                    const double *coefs = entries[ketIdx[k]].second->getCoefs();
+                    B.col(k) = Eigen::Map<const Eigen::VectorXd>(coefs + start, nCoefs);
+                }
+                S_n.noalias() = A.transpose() * B;
+                for (int b = 0; b < braIdx.size(); b++) {
+                    int i = entries[braIdx[b]].first;
+                    for (int k = 0; k < ketIdx.size(); k++) {
+                        int j = entries[ketIdx[k]].first - nBra;
+                        locS(i, j) += S_n(b, k);
+                    }
+                }
+            }
+        }
+#pragma omp critical
+        S += locS;
+    }
+
+    for (int i = 0; i < nBra; i++) {
+        for (int j = 0; j < nKet; j++) {
+            double c_j = (symmetric) ? get_coef(bra, j) : get_coef(*ket, j);
+            S(i, j) *= get_coef(bra, i) * c_j;
+        }
+    }
+    return S;
+}
+
+/** @returns Overlap matrix S_ij = <bra_i|ket_j> of two vectors of MW functions
+ *
+ * @param[in] bra: Bra side input functions
+ * @param[in] ket: Ket side input functions
+ *
+ * @details Same as calling dot(bra_i, ket_j) for all pairs, including the
+ * numerical coefficients of the vectors, but computed in a single pass over
+ * the union grid of the trees. For each node, the coefficients of all trees
+ * that have the node are collected in dense panels and multiplied as matrices.
+ * Use this for e.g. Fock-like matrices, where ket are the operator-applied
+ * functions.
+ *
+ * @note The summation order depends on the number of threads, so the result
+ * is not bitwise reproducible between runs with different thread counts.
+ *
+ */
+template <int D> Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<D> &bra, FunctionTreeVector<D> &ket) {
+    return calc_overlap(bra, &ket);
+}
+
+/** @returns Overlap matrix S_ij = <f_i|f_j> of a vector of MW functions
+ *
+ * @param[in] vec: Input functions
+ *
+ * @details Symmetric version of calc_overlap_matrix(bra, ket), where only
+ * the lower triangle of each node panel product is computed.
+ *
+ */
+template <int D> Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<D> &vec) {
+    return calc_overlap<D>(vec, nullptr);
+}
+
 /** @brief abs-dot product of two MW function representations
  *
  * @param[in] bra: Bra side input function
@@ -378,6 +598,21 @@ template void multiply(double prec,
 template void multiply(double prec, FunctionTree<1> &out, FunctionTreeVector<1> &inp, int maxIter, bool absPrec);
 template void multiply(double prec, FunctionTree<2> &out, FunctionTreeVector<2> &inp, int maxIter, bool absPrec);
 template void multiply(double prec, FunctionTree<3> &out, FunctionTreeVector<3> &inp, int maxIter, bool absPrec);
+template void sum_of_products(double prec,
+                              FunctionTree<1> &out,
+                              std::vector<FunctionTreeVector<1>> &inp,
+                              int maxIter,
+                              bool absPrec);
+template void sum_of_products(double prec,
+                              FunctionTree<2> &out,
+                              std::vector<FunctionTreeVector<2>> &inp,
+                              int maxIter,
+                              bool absPrec);
+template void sum_of_products(double prec,
+                              FunctionTree<3> &out,
+                              std::vector<FunctionTreeVector<3>> &inp,
+                              int maxIter,
+                              bool absPrec);
 template void power(double prec, FunctionTree<1> &out, FunctionTree<1> &tree, double p, int maxIter, bool absPrec);
 template void power(double prec, FunctionTree<2> &out, FunctionTree<2> &tree, double p, int maxIter, bool absPrec);
 template void power(double prec, FunctionTree<3> &out, FunctionTree<3> &tree, double p, int maxIter, bool absPrec);
@@ -406,6 +641,13 @@ template double dot(FunctionTree<1> &bra, FunctionTree<1> &ket);
 template double dot(FunctionTree<2> &bra, FunctionTree<2> &ket);
 template double dot(FunctionTree<3> &bra, FunctionTree<3> &ket);
 
+template Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<1> &bra, FunctionTreeVector<1> &ket);
+template Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<2> &bra, FunctionTreeVector<2> &ket);
+template Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<3> &bra, FunctionTreeVector<3> &ket);
+template Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<1> &vec);
+template Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<2> &vec);
+template Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<3> &vec);
+
 template double node_norm_dot(FunctionTree<1> &bra, FunctionTree<1> &ket, bool exact);
 template double node_norm_dot(FunctionTree<2> &bra, FunctionTree<2> &ket, bool exact);
 template double node_norm_dot(FunctionTree<3> &bra, FunctionTree<3> &ket, bool exact);
@@ -25,6 +25,9 @@
 
 #pragma once
 
+#include <Eigen/Core>
+#include <vector>
+
 #include "trees/FunctionTreeVector.h"
 
 namespace mrcpp {
@@ -39,6 +42,8 @@ void dot(double prec,
          int maxIter = -1,
          bool absPrec = false);
 template <int D> double dot(FunctionTree<D> &bra, FunctionTree<D> &ket);
+template <int D> Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<D> &bra, FunctionTreeVector<D> &ket);
+template <int D> Eigen::MatrixXd calc_overlap_matrix(FunctionTreeVector<D> &vec);
 template <int D> double node_norm_dot(FunctionTree<D> &bra, FunctionTree<D> &ket, bool exact = false);
 
 template <int D>
@@ -52,6 +57,12 @@ void multiply(double prec,
 template <int D>
 void multiply(double prec, FunctionTree<D> &out, FunctionTreeVector<D> &inp, int maxIter = -1, bool absPrec = false);
 template <int D>
+void sum_of_products(double prec,
+                     FunctionTree<D> &out,
+                     std::vector<FunctionTreeVector<D>> &inp,
+                     int maxIter = -1,
+                     bool absPrec = false);
+template <int D>
 void power(double prec, FunctionTree<D> &out, FunctionTree<D> &inp, double p, int maxIter = -1, bool absPrec = false);
 template <int D>
 void square(double prec, FunctionTree<D> &out, FunctionTree<D> &inp, int maxIter = -1, bool absPrec = false);
@@ -105,6 +105,95 @@ void project(double prec, FunctionTree<D> &out, RepresentableFunction<D> &inp, i
     print::separator(10, ' ');
 }
 
+/** Collect the nodes of a reprojection: the coarsest nodes that lie entirely
+ * inside the region, and the EndNodes that overlap with it. */
+template <int D>
+static void collect_region_nodes(MWNode<D> &node, const Coord<D> &lb, const Coord<D> &ub, MWNodeVector<D> &nodes) {
+    double node_lb[D], node_ub[D];
+    node.getBounds(node_lb, node_ub);
+    bool inside = true;
+    for (int d = 0; d < D; d++) {
+        if (node_ub[d] <= lb[d] or node_lb[d] >= ub[d]) return;
+        if (node_lb[d] < lb[d] or node_ub[d] > ub[d]) inside = false;
+    }
+    if (inside or node.isEndNode()) {
+        nodes.push_back(&node);
+    } else {
+        for (int i = 0; i < node.getTDim(); i++) collect_region_nodes<D>(node.getMWChild(i), lb, ub, nodes);
+    }
+}
+
+/** Squared norm of the function on the support of node, i.e. the sum of the
+ * norms of the EndNodes of its subtree. */
+template <int D> static double subtree_square_norm(const MWNode<D> &node) {
+    if (node.isEndNode()) return node.getSquareNorm();
+    double sqNorm = 0.0;
+    for (int i = 0; i < node.getTDim(); i++) sqNorm += subtree_square_norm<D>(node.getMWChild(i));
+    return sqNorm;
+}
+
+/** @brief Re-project an analytic function in a region of an existing tree
+ *
+ * @param[in] prec: Build precision of output function
+ * @param[in,out] out: Previous projection, to be updated
+ * @param[in] inp: Input function
+ * @param[in] lb: Lower bounds of the region where the function has changed
+ * @param[in] ub: Upper bounds of the region where the function has changed
+ * @param[in] maxIter: Maximum number of refinement iterations in output tree
+ * @param[in] absPrec: Build output tree based on absolute precision
+ *
+ * @details The input function is assumed to be equal to the one previously
+ * projected onto `out`, except within the region `[lb, ub]`. Only the nodes
+ * overlapping with this region are recomputed: the subtrees that lie entirely
+ * inside the region are removed and rebuilt from their root, while the
+ * EndNodes on the border of the region are recomputed and refined further.
+ * The MW transform is then performed only on the rebuilt subtrees and along
+ * the paths to their root nodes, using the general algorithm:
+ * - Compute MW coefs on current grid
+ * - Refine grid where necessary based on `prec`
+ * - Repeat until convergence or `maxIter` is reached
+ * - `prec < 0` or `maxIter = 0` means NO refinement
+ * - `maxIter < 0` means no bound
+ *
+ * @note The grid outside the region, and of the border nodes, is never
+ * coarsened.
+ *
+ */
+template <int D>
+void reproject(double prec,
+               FunctionTree<D> &out,
+               RepresentableFunction<D> &inp,
+               const Coord<D> &lb,
+               const Coord<D> &ub,
+               int maxIter,
+               bool absPrec) {
+    if (out.getSquareNorm() < 0.0) MSG_ABORT("Output tree has no coefs");
+
+    MWNodeVector<D> nodes;
+    for (int i = 0; i < out.getRootBox().size(); i++) collect_region_nodes<D>(out.getRootMWNode(i), lb, ub, nodes);
+
+    // norm of the tree outside the region, for relative precision
+    double restNorm = out.getSquareNorm();
+    for (auto *node : nodes) restNorm -= subtree_square_norm<D>(*node);
+    for (auto *node : nodes) node->deleteChildren();
+
+    int maxScale = out.getMRA().getMaxScale();
+    const auto scaling_factor = out.getMRA().getWorldBox().getScalingFactor();
+    TreeBuilder<D> builder;
+    WaveletAdaptor<D> adaptor(prec, maxScale, absPrec);
+    ProjectionCalculator<D> calculator(inp, scaling_factor);
+
+    builder.rebuild(out, calculator, adaptor, nodes, restNorm, maxIter);
+
+    Timer trans_t;
+    out.mwTransformSubtrees(nodes);
+    out.calcSquareNorm();
+    trans_t.stop();
+
+    print::time(10, "Time transform", trans_t);
+    print::separator(10, ' ');
+}
+
 /** @brief Project an analytic vector function onto the MW basis, adaptive grid
  *
  * @param[in] prec: Build precision of output function
@@ -138,6 +227,27 @@ void project(double prec,
 template void project<1>(double prec, FunctionTree<1> &out, RepresentableFunction<1> &inp, int maxIter, bool absPrec);
 template void project<2>(double prec, FunctionTree<2> &out, RepresentableFunction<2> &inp, int maxIter, bool absPrec);
 template void project<3>(double prec, FunctionTree<3> &out, RepresentableFunction<3> &inp, int maxIter, bool absPrec);
+template void reproject<1>(double prec,
+                           FunctionTree<1> &out,
+                           RepresentableFunction<1> &inp,
+                           const Coord<1> &lb,
+                           const Coord<1> &ub,
+                           int maxIter,
+                           bool absPrec);
+template void reproject<2>(double prec,
+                           FunctionTree<2> &out,
+                           RepresentableFunction<2> &inp,
+                           const Coord<2> &lb,
+                           const Coord<2> &ub,
+                           int maxIter,
+                           bool absPrec);
+template void reproject<3>(double prec,
+                           FunctionTree<3> &out,
+                           RepresentableFunction<3> &inp,
+                           const Coord<3> &lb,
+                           const Coord<3> &ub,
+                           int maxIter,
+                           bool absPrec);
 template void project<1>(double prec,
                          FunctionTree<1> &out,
                          std::function<double(const Coord<1> &r)> func,
@@ -33,6 +33,14 @@ namespace mrcpp {
 template <int D>
 void project(double prec, FunctionTree<D> &out, RepresentableFunction<D> &inp, int maxIter = -1, bool absPrec = false);
 template <int D>
+void reproject(double prec,
+               FunctionTree<D> &out,
+               RepresentableFunction<D> &inp,
+               const Coord<D> &lb,
+               const Coord<D> &ub,
+               int maxIter = -1,
+               bool absPrec = false);
+template <int D>
 void project(double prec,
              FunctionTree<D> &out,
              std::function<double(const Coord<D> &r)> func,
@@ -0,0 +1,132 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#include "ChunkPool.h"
+#include "utils/Printer.h"
+#include "utils/numa_utils.h"
+
+namespace mrcpp {
+
+bool ChunkPool::enabled = false;
+int ChunkPool::highWaterMark = 64;
+int ChunkPool::nCached = 0;
+std::map<std::pair<int, int>, std::vector<ChunkPool::Chunk>> ChunkPool::chunks;
+
+/** @brief Turn chunk recycling on or off
+ *
+ *  @details Disabling the pool frees all cached chunks.
+ */
+void ChunkPool::setEnabled(bool enable) {
+    enabled = enable;
+    if (not enabled) trim(0);
+}
+
+/** @brief Set the maximum number of cached chunks
+ *
+ *  @param[in] nChunks: Maximum number of chunks kept, over all keys
+ *
+ *  @details Cached chunks above the new limit are freed immediately.
+ */
+void ChunkPool::setHighWaterMark(int nChunks) {
+    if (nChunks < 0) MSG_ABORT("Invalid high-water mark");
+    highWaterMark = nChunks;
+    trim(highWaterMark);
+}
+
+/** @returns Total number of cached chunks */
+int ChunkPool::getNCached() {
+    int n = 0;
+#pragma omp critical(chunk_pool)
+    n = nCached;
+    return n;
+}
+
+/** @returns Number of cached chunks for trees of the given kind */
+int ChunkPool::getNCached(int dim, int kp1_d) {
+    int n = 0;
+#pragma omp critical(chunk_pool)
+    {
+        auto it = chunks.find(std::make_pair(dim, kp1_d));
+        if (it != chunks.end()) n = it->second.size();
+    }
+    return n;
+}
+
+/** @brief Free cached chunks until at most nChunks remain */
+void ChunkPool::trim(int nChunks) {
+#pragma omp critical(chunk_pool)
+    for (auto &entry : chunks) {
+        std::vector<Chunk> &stack = entry.second;
+        while (nCached > nChunks and not stack.empty()) {
+            freeChunk(stack.back());
+            stack.pop_back();
+            nCached--;
+        }
+    }
+}
+
+/** @brief Take a chunk from the pool
+ *
+ *  @returns False if the pool is disabled or has no chunk of the given kind
+ */
+bool ChunkPool::pop(int dim, int kp1_d, char **nodes, double **coefs) {
+    if (not enabled) return false;
+    bool found = false;
+#pragma omp critical(chunk_pool)
+    {
+        auto it = chunks.find(std::make_pair(dim, kp1_d));
+        if (it != chunks.end() and not it->second.empty()) {
+            *nodes = it->second.back().nodes;
+            *coefs = it->second.back().coefs;
+            it->second.pop_back();
+            nCached--;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/** @brief Give a chunk to the pool
+ *
+ *  @returns False if the chunk was not taken, it must then be freed by the caller
+ */
+bool ChunkPool::push(int dim, int kp1_d, char *nodes, double *coefs, int nDoubles) {
+    if (not enabled) return false;
+    bool taken = false;
+#pragma omp critical(chunk_pool)
+    if (nCached < highWaterMark) {
+        chunks[std::make_pair(dim, kp1_d)].push_back({nodes, coefs, nDoubles});
+        nCached++;
+        taken = true;
+    }
+    return taken;
+}
+
+void ChunkPool::freeChunk(Chunk &chunk) {
+    delete[] chunk.nodes;
+    numa_utils::free_chunk(chunk.coefs, chunk.nDoubles);
+}
+
+} // namespace mrcpp
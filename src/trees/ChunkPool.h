@@ -0,0 +1,83 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace mrcpp {
+
+/** @class ChunkPool
+ *
+ * @brief Process-wide recycler of SerialFunctionTree memory chunks
+ *
+ * @details When enabled, a SerialFunctionTree returns its ProjectedNode and
+ * coefficient chunks to the pool when they are released, instead of freeing
+ * them, and draws from the pool before allocating new ones. Chunks are keyed
+ * by the dimension and the number of scaling coefficients per node, (D, kp1_d),
+ * so any tree of the same kind can pick them up. This removes most allocation
+ * and page fault overhead when short-lived trees are created repeatedly.
+ *
+ * The number of cached chunks is bounded by the high-water mark, chunks
+ * returned beyond it are freed. Recycled pages keep their NUMA placement
+ * from their first use, and chunks on huge pages are never pooled.
+ *
+ */
+
+class ChunkPool final {
+public:
+    static void setEnabled(bool enable);
+    static bool isEnabled() { return enabled; }
+
+    static void setHighWaterMark(int nChunks);
+    static int getHighWaterMark() { return highWaterMark; }
+
+    static int getNCached();
+    static int getNCached(int dim, int kp1_d);
+    static void trim(int nChunks = 0);
+
+    static bool pop(int dim, int kp1_d, char **nodes, double **coefs);
+    static bool push(int dim, int kp1_d, char *nodes, double *coefs, int nDoubles);
+
+private:
+    struct Chunk {
+        char *nodes;   // ProjectedNode chunk, allocated with new char[]
+        double *coefs; // coefficient chunk, allocated with numa_utils::alloc_chunk
+        int nDoubles;  // size of the coefficient chunk
+    };
+
+    static bool enabled;
+    static int highWaterMark;
+    static int nCached;
+    static std::map<std::pair<int, int>, std::vector<Chunk>> chunks;
+
+    ChunkPool() = delete; // No instances of this class
+
+    static void freeChunk(Chunk &chunk);
+};
+
+} // namespace mrcpp
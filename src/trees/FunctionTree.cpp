@@ -23,6 +23,7 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <algorithm>
 #include <fstream>
 
 #include "FunctionNode.h"
@@ -88,8 +89,29 @@ template <int D> void FunctionTree<D>::clear() {
     this->getSerialFunctionTree()->clear(this->rootBox.size());
 }
 
+/** File header of a stored FunctionTree, version 1 */
+struct FunctionTreeHeader {
+    char magic[4];        // "MRFT"
+    int version;          // file format version
+    int dim;              // dimension D
+    int scalingType;      // Interpol or Legendre
+    int scalingOrder;     // polynomial order of the basis
+    int maxNodesPerChunk; // nodes per memory chunk
+    int sizeNodeCoeff;    // coefficients per node
+    int nChunks;          // number of chunks stored
+    int coefSize;         // bytes per stored coefficient, 4 or 8
+    int reserved;         // keeps the topology 8 byte aligned
+};
+
+static const int function_tree_version = 1;
+
 /** @brief Write the tree structure to disk, for later use
  * @param[in] file: File name, will get ".tree" extension
+ *
+ * @details The file contains a versioned header, the packed node topology
+ * (see SerialFunctionTree::packTopology) and the coefficient chunks,
+ * i.e. no pointers are stored. Coefficients are written in the storage
+ * precision of the tree.
  */
 template <int D> void FunctionTree<D>::saveTree(const std::string &file) {
     // This is basically a copy of MPI send_tree
@@ -104,17 +126,41 @@ template <int D> void FunctionTree<D>::saveTree(const std::string &file) {
     this->deleteGenerated();
     SerialFunctionTree<D> &sTree = *this->getSerialFunctionTree();
 
-    // Write size of tree
+    // Write size of tree and of the stored coefficients
     int nChunks = sTree.getNChunksUsed();
-    f.write((char *)&nChunks, sizeof(int));
-
-    // Write tree data, chunk by chunk
-    int count = 1;
+    int coefSize = (sTree.isSinglePrecision()) ? sizeof(float) : sizeof(double);
+    FunctionTreeHeader header{};
+    std::copy_n("MRFT", 4, header.magic);
+    header.version = function_tree_version;
+    header.dim = D;
+    header.scalingType = this->getMRA().getScalingBasis().getScalingType();
+    header.scalingOrder = this->getMRA().getScalingBasis().getScalingOrder();
+    header.maxNodesPerChunk = sTree.maxNodesPerChunk;
+    header.sizeNodeCoeff = sTree.sizeNodeCoeff;
+    header.nChunks = nChunks;
+    header.coefSize = coefSize;
+    f.write((char *)&header, sizeof(FunctionTreeHeader));
+
+    sTree.packTopology(nChunks);
+    int nSlots = sTree.topoStatus.size();
+
+    // Write node topology
+    f.write((char *)sTree.topoStatus.data(), nSlots * sizeof(unsigned char));
+    f.write((char *)sTree.topoScale.data(), nSlots * sizeof(short int));
+    f.write((char *)sTree.topoTranslation.data(), D * nSlots * sizeof(int));
+    f.write((char *)sTree.topoParentIx.data(), nSlots * sizeof(int));
+    f.write((char *)sTree.topoChildIx.data(), nSlots * sizeof(int));
+    f.write((char *)sTree.topoNorms.data(), sTree.topoNorms.size() * sizeof(double));
+    sTree.clearTopology();
+
+    // Write coefficients, chunk by chunk
+    int count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
     for (int iChunk = 0; iChunk < nChunks; iChunk++) {
-        count = sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>);
-        f.write((char *)sTree.nodeChunks[iChunk], count);
-        count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
-        f.write((char *)sTree.nodeCoeffChunks[iChunk], count * sizeof(double));
+        if (sTree.isSinglePrecision()) {
+            f.write((char *)sTree.nodeCoeffChunksSP[iChunk], count * sizeof(float));
+        } else {
+            f.write((char *)sTree.nodeCoeffChunks[iChunk], count * sizeof(double));
+        }
     }
     f.close();
     print::time(10, "Time write", t1);
@@ -134,47 +180,64 @@ template <int D> void FunctionTree<D>::loadTree(const std::string &file) {
     f.open(fname.str(), std::ios::in | std::ios::binary);
     if (not f.is_open()) MSG_ERROR("Unable to open file");
 
-    // Read size of tree
-    int nChunks;
-    f.read((char *)&nChunks, sizeof(int));
+    // Read size of tree and of the stored coefficients
+    FunctionTreeHeader header{};
+    f.read((char *)&header, sizeof(FunctionTreeHeader));
+    if (not f or std::string(header.magic, 4) != "MRFT") MSG_ABORT("Invalid tree file");
+    if (header.version != function_tree_version) MSG_ABORT("Unsupported tree file version " << header.version);
+    this->setSinglePrecision(false);
     SerialFunctionTree<D> &sTree = *this->getSerialFunctionTree();
-
-    // Read tree data, chunk by chunk
-    int count = 1;
+    if (header.dim != D or header.scalingType != this->getMRA().getScalingBasis().getScalingType() or
+        header.scalingOrder != this->getMRA().getScalingBasis().getScalingOrder() or
+        header.maxNodesPerChunk != sTree.maxNodesPerChunk or header.sizeNodeCoeff != sTree.sizeNodeCoeff) {
+        MSG_ABORT("Tree file does not match the MRA");
+    }
+    int nChunks = header.nChunks;
+    int coefSize = header.coefSize;
+    if (nChunks < 0) MSG_ABORT("Invalid number of chunks in tree file");
+    if (coefSize != sizeof(float) and coefSize != sizeof(double)) MSG_ABORT("Invalid coefficient size in tree file");
+    int nSlots = nChunks * sTree.maxNodesPerChunk;
+
+    // Read node topology
+    sTree.topoStatus.resize(nSlots);
+    sTree.topoScale.resize(nSlots);
+    sTree.topoTranslation.resize(D * nSlots);
+    sTree.topoParentIx.resize(nSlots);
+    sTree.topoChildIx.resize(nSlots);
+    sTree.topoNorms.resize((this->getTDim() + 1) * nSlots);
+    f.read((char *)sTree.topoStatus.data(), nSlots * sizeof(unsigned char));
+    f.read((char *)sTree.topoScale.data(), nSlots * sizeof(short int));
+    f.read((char *)sTree.topoTranslation.data(), D * nSlots * sizeof(int));
+    f.read((char *)sTree.topoParentIx.data(), nSlots * sizeof(int));
+    f.read((char *)sTree.topoChildIx.data(), nSlots * sizeof(int));
+    f.read((char *)sTree.topoNorms.data(), sTree.topoNorms.size() * sizeof(double));
+
+    // Read coefficients, chunk by chunk
+    while (sTree.nodeChunks.size() < nChunks) sTree.appendChunk();
+    int count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
+    std::vector<float> buffer((coefSize == sizeof(float)) ? count : 0);
     for (int iChunk = 0; iChunk < nChunks; iChunk++) {
-        if (iChunk < sTree.nodeChunks.size()) {
-            sTree.sNodes = sTree.nodeChunks[iChunk];
+        if (coefSize == sizeof(float)) {
+            // single precision coefficients are widened on the fly
+            f.read((char *)buffer.data(), count * sizeof(float));
+            std::copy(buffer.begin(), buffer.end(), sTree.nodeCoeffChunks[iChunk]);
         } else {
-            double *sNodesCoeff;
-            if (sTree.isShared()) {
-                // for coefficients, take from the shared memory block
-                SharedMemory *shMem = sTree.getMemory();
-                sNodesCoeff = shMem->sh_end_ptr;
-                shMem->sh_end_ptr += (sTree.sizeNodeCoeff * sTree.maxNodesPerChunk);
-                // may increase size dynamically in the future
-                if (shMem->sh_max_ptr < shMem->sh_end_ptr) MSG_ABORT("Shared block too small");
-            } else {
-                sNodesCoeff = new double[sTree.sizeNodeCoeff * sTree.maxNodesPerChunk];
-            }
-            sTree.nodeCoeffChunks.push_back(sNodesCoeff);
-            sTree.sNodes = (ProjectedNode<D> *)new char[sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>)];
-            sTree.nodeChunks.push_back(sTree.sNodes);
+            f.read((char *)sTree.nodeCoeffChunks[iChunk], count * sizeof(double));
         }
-        count = sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>);
-        f.read((char *)sTree.nodeChunks[iChunk], count);
-        count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
-        f.read((char *)sTree.nodeCoeffChunks[iChunk], count * sizeof(double));
     }
+    if (not f) MSG_ABORT("Corrupt tree file");
     f.close();
     print::time(10, "Time read tree", t1);
 
     Timer t2;
-    sTree.rewritePointers();
-    print::time(10, "Time rewrite pointers", t2);
+    sTree.unpackTopology();
+    sTree.clearTopology();
+    print::time(10, "Time unpack topology", t2);
 }
 
 /** @returns Integral of the function over the entire computational domain */
 template <int D> double FunctionTree<D>::integrate() const {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     double result = 0.0;
     for (int i = 0; i < this->rootBox.size(); i++) {
@@ -206,6 +269,7 @@ template <int D> double FunctionTree<D>::integrate() const {
  *       that can be done in OMP parallel.
  */
 template <int D> double FunctionTree<D>::evalf(const Coord<D> &r) const {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     // Handle potential scaling
     const auto sf = this->getMRA().getWorldBox().getScalingFactor();
     auto arg = r;
@@ -235,6 +299,7 @@ template <int D> double FunctionTree<D>::evalf(const Coord<D> &r) const {
  *
  */
 template <int D> void FunctionTree<D>::square() {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
 
 #pragma omp parallel
@@ -266,6 +331,7 @@ template <int D> void FunctionTree<D>::square() {
  *
  */
 template <int D> void FunctionTree<D>::power(double p) {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
 
 #pragma omp parallel
@@ -297,6 +363,7 @@ template <int D> void FunctionTree<D>::power(double p) {
  *
  */
 template <int D> void FunctionTree<D>::rescale(double c) {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
 #pragma omp parallel firstprivate(c)
     {
@@ -333,6 +400,7 @@ template <int D> void FunctionTree<D>::normalize() {
  *
  */
 template <int D> void FunctionTree<D>::add(double c, FunctionTree<D> &inp) {
+    if (this->isSinglePrecision() or inp.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
 #pragma omp parallel firstprivate(c), shared(inp)
@@ -363,6 +431,7 @@ template <int D> void FunctionTree<D>::add(double c, FunctionTree<D> &inp) {
  *
  */
 template <int D> void FunctionTree<D>::multiply(double c, FunctionTree<D> &inp) {
+    if (this->isSinglePrecision() or inp.isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getMRA() != inp.getMRA()) MSG_ABORT("Incompatible MRA");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
 #pragma omp parallel firstprivate(c), shared(inp)
@@ -398,6 +467,7 @@ template <int D> int FunctionTree<D>::getNChunksUsed() {
 }
 
 template <int D> void FunctionTree<D>::getEndValues(VectorXd &data) {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
     int nNodes = this->getNEndNodes();
     int nCoefs = this->getTDim() * this->getKp1_d();
@@ -414,6 +484,7 @@ template <int D> void FunctionTree<D>::getEndValues(VectorXd &data) {
 }
 
 template <int D> void FunctionTree<D>::setEndValues(VectorXd &data) {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
     if (this->getNGenNodes() != 0) MSG_ABORT("GenNodes not cleared");
     int nNodes = this->getNEndNodes();
     int nCoefs = this->getTDim() * this->getKp1_d();
@@ -472,6 +543,7 @@ template <int D> void FunctionTree<D>::printSerialIndices() {
  * to the dimension; in practice, it is set to `s=1`.
  */
 template <int D> int FunctionTree<D>::crop(double prec, double splitFac, bool absPrec) {
+    if (this->isSinglePrecision()) MSG_ABORT("Tree is stored in single precision");
 
     for (int i = 0; i < this->rootBox.size(); i++) {
         MWNode<D> &root = this->getRootMWNode(i);
@@ -483,6 +555,79 @@ template <int D> int FunctionTree<D>::crop(double prec, double splitFac, bool ab
     return nChunks;
 }
 
+/** @returns Number of chunks released
+ *
+ * @brief Defragment the memory of the tree
+ *
+ * @details All nodes and coefficients are rewritten into fresh chunks in the
+ * order of a HilbertIterator traversal, and the old memory is released. This
+ * squeezes out the holes left by crop() and clear(), so the footprint is
+ * brought down to the live nodes and tree traversals run sequentially
+ * through memory. Generated nodes are removed.
+ */
+template <int D> int FunctionTree<D>::repack() {
+    this->deleteGenerated();
+    return this->getSerialFunctionTree()->repack();
+}
+
+/** @brief Change the storage precision of the coefficients
+ *
+ * @param[in] single: Store the coefficients in single precision
+ *
+ * @details Single precision storage halves the coefficient memory of the
+ * tree, as well as the size of saveTree() files and send_tree() messages.
+ * Node norms are kept in double precision, so getSquareNorm() and the tree
+ * structure are unaffected. All arithmetic is done in double precision: a
+ * tree stored in single precision can be used as input of the builders that
+ * read it through getNodeCoefs() and getNodeValues() (add, multiply, square,
+ * power and sum_of_products), which widen the coefficients node by node. All
+ * other computations abort (the nodes report no coefficients), and the tree
+ * must be converted back with setSinglePrecision(false) first. Loading or
+ * receiving a single precision tree gives a double precision tree.
+ * Generated nodes are removed.
+ */
+template <int D> void FunctionTree<D>::setSinglePrecision(bool single) {
+    this->deleteGenerated();
+    if (single) {
+        this->getSerialFunctionTree()->toSinglePrecision();
+    } else {
+        this->getSerialFunctionTree()->toDoublePrecision();
+    }
+}
+
+/** Compressed coefs of the node with the given NodeIndex, see
+ * MWTree::getNodeCoefs. In single precision storage the coefs of the EndNode
+ * are first widened into c. */
+template <int D> void FunctionTree<D>::getNodeCoefs(NodeIndex<D> idx, double *c) const {
+    if (not this->isSinglePrecision()) {
+        MWTree<D>::getNodeCoefs(idx, c);
+        return;
+    }
+    if (this->getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, this->getRootBox().getPeriodic()); }
+    const MWNode<D> &node = this->getNodeOrEndNode(idx);
+    auto *sTree = static_cast<const SerialFunctionTree<D> *>(this->serialTree_p);
+    if (not sTree->widenCoefs(node, c)) MSG_ABORT("Node has no coefs");
+    node.calcDescendantCoefs(idx, c, true);
+}
+
+/** Function values in the quadrature points of the children of the node
+ * with the given NodeIndex, see MWTree::getNodeValues and getNodeCoefs. */
+template <int D> void FunctionTree<D>::getNodeValues(NodeIndex<D> idx, double *vals) const {
+    if (not this->isSinglePrecision()) {
+        MWTree<D>::getNodeValues(idx, vals);
+        return;
+    }
+    if (this->getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, this->getRootBox().getPeriodic()); }
+    const MWNode<D> &node = this->getNodeOrEndNode(idx);
+    auto *sTree = static_cast<const SerialFunctionTree<D> *>(this->serialTree_p);
+    if (not sTree->widenCoefs(node, vals)) MSG_ABORT("Node has no coefs");
+    node.calcDescendantValues(idx, vals, true);
+}
+
+template <int D> bool FunctionTree<D>::isSinglePrecision() const {
+    return static_cast<const SerialFunctionTree<D> *>(this->serialTree_p)->isSinglePrecision();
+}
+
 template class FunctionTree<1>;
 template class FunctionTree<2>;
 template class FunctionTree<3>;
@@ -78,6 +78,13 @@ public:
     int getNChunksUsed();
 
     int crop(double prec, double splitFac = 1.0, bool absPrec = true);
+    int repack();
+
+    void setSinglePrecision(bool single);
+    bool isSinglePrecision() const;
+
+    void getNodeCoefs(NodeIndex<D> nIdx, double *c) const override;
+    void getNodeValues(NodeIndex<D> nIdx, double *vals) const override;
 
     FunctionNode<D> &getEndFuncNode(int i) { return static_cast<FunctionNode<D> &>(this->getEndMWNode(i)); }
     FunctionNode<D> &getRootFuncNode(int i) { return static_cast<FunctionNode<D> &>(this->rootBox.getNode(i)); }
@@ -30,6 +30,7 @@
 #include "MWNode.h"
 #include "GenNode.h"
 #include "MWTree.h"
+#include "NodeHashTable.h"
 #include "ProjectedNode.h"
 #include "SerialTree.h"
 #include "core/QuadratureCache.h"
@@ -204,139 +205,28 @@ template <int D> void MWNode<D>::copyCoefsFromChildren() {
     }
 }
 
-/** Generates children nodes in a thread safe manner if (*this) is a leaf node */
+/** Generates children nodes in a thread safe manner if (*this) is a leaf node
+ *
+ * The node status goes from leaf to generating to branch. Only the thread that
+ * succeeds in setting the generating flag on a leaf node (compare-and-swap)
+ * creates the children and gives them coefficients. Other threads asking for
+ * the same children wait until the flag is released, which also guarantees
+ * that they see the complete children. */
 template <int D> void MWNode<D>::threadSafeGenChildren() {
-    // set_node_lock caused segmentation errors seldom and randomly -> avoided
-
-    // we make many copies of the genChildren calls
-    // the chance that 2 different nodes are treated in the same copy is small and therefore
-    // the different critical sections will not interfer too much
-    if (this->isLeafNode() or this->lockX != 0) {
-        this->lockX = 1;
-
-        int nCritical = 16;
-        switch (this->serialIx % nCritical) {
-            case 0:
-#pragma omp critical(g0)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 1:
-#pragma omp critical(g1)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 2:
-#pragma omp critical(g2)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 3:
-#pragma omp critical(g3)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 4:
-#pragma omp critical(g4)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 5:
-#pragma omp critical(g5)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 6:
-#pragma omp critical(g6)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 7:
-#pragma omp critical(g7)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 8:
-#pragma omp critical(g8)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 9:
-#pragma omp critical(g9)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 10:
-#pragma omp critical(g10)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 11:
-#pragma omp critical(g11)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 12:
-#pragma omp critical(g12)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 13:
-#pragma omp critical(g13)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 14:
-#pragma omp critical(g14)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            case 15:
-#pragma omp critical(g15)
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
-                break;
-            default:
-#pragma omp critical
-                if (isLeafNode()) {
-                    genChildren();
-                    giveChildrenCoefs();
-                }
+    unsigned char old = this->status.load(std::memory_order_acquire);
+    while (true) {
+        if (old & FlagGenerating) {
+            // another thread is generating the children
+            old = this->status.load(std::memory_order_acquire);
+        } else if (old & FlagBranchNode) {
+            return;
+        } else if (this->status.compare_exchange_weak(old, old | FlagGenerating, std::memory_order_acquire)) {
+            break;
         }
-        this->lockX = 0;
     }
+    genChildren();
+    giveChildrenCoefs();
+    this->status.fetch_and(static_cast<unsigned char>(~FlagGenerating), std::memory_order_release);
 }
 
 /** Coefficient-Value transform
@@ -349,16 +239,25 @@ template <int D> void MWNode<D>::threadSafeGenChildren() {
  * NOTE: this routine assumes a 0/1 (scaling on children 0 and 1)
  *       representation, in oppose to s/d (scaling and wavelet). */
 template <int D> void MWNode<D>::cvTransform(int operation) {
+    cvTransformCoefs(operation, this->coefs, getScale());
+}
+
+/** Coefficient-Value transform of an external coefficient vector
+ *
+ * Same as cvTransform, but operates on the full (2^D * (k+1)^D) vector c
+ * of a node at the given scale instead of the node's own coefs, which are
+ * left untouched. */
+template <int D> void MWNode<D>::cvTransformCoefs(int operation, double *c, int scale) const {
     int kp1 = this->getKp1();
     int kp1_dm1 = math_utils::ipow(kp1, D - 1);
     int kp1_d = this->getKp1_d();
     int nCoefs = this->getTDim() * kp1_d;
 
-    auto sb = this->getMWTree().getMRA().getScalingBasis();
+    const auto &sb = this->getMWTree().getMRA().getScalingBasis();
     const MatrixXd &S = sb.getCVMap(operation);
     double o_vec[nCoefs];
     double *out_vec = o_vec;
-    double *in_vec = this->coefs;
+    double *in_vec = c;
 
     for (int i = 0; i < D; i++) {
         for (int t = 0; t < this->getTDim(); t++) {
@@ -376,7 +275,7 @@ template <int D> void MWNode<D>::cvTransform(int operation) {
     for (const auto &s : sf) sf_prod *= s;
     if (sf_prod <= MachineZero) sf_prod = 1.0; // When there is no scaling factor
 
-    int np1 = getScale() + 1; // we're working on scaling coefs on next scale
+    int np1 = scale + 1; // we're working on scaling coefs on next scale
     double two_fac = std::pow(2.0, D * np1) / sf_prod;
     if (operation == Backward) {
         two_fac = std::sqrt(1.0 / two_fac);
@@ -384,9 +283,9 @@ template <int D> void MWNode<D>::cvTransform(int operation) {
         two_fac = std::sqrt(two_fac);
     }
     if (IS_ODD(D)) {
-        for (int i = 0; i < nCoefs; i++) { this->coefs[i] = two_fac * in_vec[i]; }
+        for (int i = 0; i < nCoefs; i++) { c[i] = two_fac * in_vec[i]; }
     } else {
-        for (int i = 0; i < nCoefs; i++) { this->coefs[i] *= two_fac; }
+        for (int i = 0; i < nCoefs; i++) { c[i] *= two_fac; }
     }
 }
 /* Old interpolating version, somewhat faster
@@ -456,6 +355,14 @@ void MWNode<D>::cvTransform(int operation) {
   * Luca Frediani, August 2006
   * C++ version: Jonas Juselius, September 2009 */
 template <int D> void MWNode<D>::mwTransform(int operation) {
+    mwTransformCoefs(operation, this->coefs);
+}
+
+/** Multiwavelet transform of an external coefficient vector
+ *
+ * Same as mwTransform, but operates on the full (2^D * (k+1)^D) vector c
+ * instead of the node's own coefs, which are left untouched. */
+template <int D> void MWNode<D>::mwTransformCoefs(int operation, double *c) const {
     int kp1 = this->getKp1();
     int kp1_dm1 = math_utils::ipow(kp1, D - 1);
     int kp1_d = this->getKp1_d();
@@ -465,7 +372,7 @@ template <int D> void MWNode<D>::mwTransform(int operation) {
 
     double o_vec[nCoefs];
     double *out_vec = o_vec;
-    double *in_vec = this->coefs;
+    double *in_vec = c;
 
     for (int i = 0; i < D; i++) {
         int mask = 1 << i;
@@ -490,10 +397,62 @@ template <int D> void MWNode<D>::mwTransform(int operation) {
         out_vec = tmp;
     }
     if (IS_ODD(D)) {
-        for (int i = 0; i < nCoefs; i++) { this->coefs[i] = in_vec[i]; }
+        for (int i = 0; i < nCoefs; i++) { c[i] = in_vec[i]; }
     }
 }
 
+/** Function values in the quadrature points of the children
+ *
+ * Reconstructs the node coefs into the external vector vals, which must hold
+ * 2^D * (k+1)^D values, and transforms them to function values. The node
+ * itself is not modified, and no memory is allocated, so this can be used on
+ * GenNodes (missing wavelet coefs are taken as zero) and on shared input
+ * nodes from several threads. */
+template <int D> void MWNode<D>::calcValues(double *vals) const {
+    calcDescendantValues(getNodeIndex(), vals);
+}
+
+/** Compressed coefs of a (possibly non-existing) descendant node
+ *
+ * Computes the coefs of the descendant idx of this node into the external
+ * vector c, which must hold 2^D * (k+1)^D values. The scaling coefs are
+ * obtained by repeated reconstruction from this node, and the wavelet coefs
+ * of levels below this node are zero. This is what a GenNode would hold, but
+ * no nodes are created and the tree is not modified. If idx is this node its
+ * coefs are simply copied. With loaded, c already holds the coefs of this
+ * node on entry, e.g. widened from single precision storage, and the coefs
+ * of the node itself are not read. */
+template <int D> void MWNode<D>::calcDescendantCoefs(const NodeIndex<D> &idx, double *c, bool loaded) const {
+    assert(getNodeIndex() == idx or isAncestor(idx));
+    int kp1_d = this->getKp1_d();
+    int nCoefs = this->getTDim() * kp1_d;
+    if (not loaded) {
+        if (not this->hasCoefs()) MSG_ABORT("Node has no coefs");
+        for (int i = 0; i < this->n_coefs; i++) { c[i] = this->coefs[i]; }
+    }
+    for (int i = this->n_coefs; i < nCoefs; i++) { c[i] = 0.0; }
+
+    for (int n = getScale(); n < idx.getScale(); n++) {
+        // reconstruct into children scaling coefs (one block per child)
+        mwTransformCoefs(Reconstruction, c);
+        int cIdx = 0;
+        int diffScale = idx.getScale() - n - 1;
+        for (int d = 0; d < D; d++) { cIdx += ((idx.getTranslation()[d] >> diffScale) & 1) << d; }
+        if (cIdx != 0) {
+            for (int i = 0; i < kp1_d; i++) { c[i] = c[cIdx * kp1_d + i]; }
+        }
+        for (int i = kp1_d; i < nCoefs; i++) { c[i] = 0.0; }
+    }
+}
+
+/** Function values in the quadrature points of the children of a (possibly
+ * non-existing) descendant node, see calcDescendantCoefs and calcValues. */
+template <int D> void MWNode<D>::calcDescendantValues(const NodeIndex<D> &idx, double *vals, bool loaded) const {
+    calcDescendantCoefs(idx, vals, loaded);
+    mwTransformCoefs(Reconstruction, vals);
+    cvTransformCoefs(Forward, vals, idx.getScale());
+}
+
 /** Set all norms to Undefined. */
 template <int D> void MWNode<D>::clearNorms() {
     this->squareNorm = -1.0;
@@ -623,6 +582,16 @@ template <int D> double MWNode<D>::getScaleFactor(double splitFac, bool absPrec)
 template <int D> void MWNode<D>::createChildren() {
     if (this->isBranchNode()) MSG_ABORT("Node already has children");
     this->getMWTree().getSerialTree()->allocChildren(*this);
+    this->flagChildrenCreated();
+    NodeHashTable<D> *table = this->getMWTree().nodeHashTable;
+    if (table != nullptr) {
+        for (int cIdx = 0; cIdx < getTDim(); cIdx++) table->insert(this->children[cIdx]);
+    }
+}
+
+/** Update the status flags once the children have been allocated, by
+ * createChildren or MWTree::createChildren. */
+template <int D> void MWNode<D>::flagChildrenCreated() {
     this->setIsBranchNode();
 }
 
@@ -638,6 +607,8 @@ template <int D> void MWNode<D>::deleteChildren() {
         if (this->children[cIdx] != nullptr) {
             MWNode<D> &child = getMWChild(cIdx);
             child.deleteChildren();
+            NodeHashTable<D> *table = this->getMWTree().nodeHashTable;
+            if (table != nullptr and not child.isGenNode()) table->remove(child.getNodeIndex());
             child.dealloc();
         }
         this->children[cIdx] = nullptr;
@@ -29,6 +29,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include <Eigen/Core>
 
 #include "MRCPP/macros.h"
@@ -122,6 +124,9 @@ public:
 
     virtual void cvTransform(int kind);
     virtual void mwTransform(int kind);
+    void calcValues(double *vals) const;
+    void calcDescendantCoefs(const NodeIndex<D> &idx, double *c, bool loaded = false) const;
+    void calcDescendantValues(const NodeIndex<D> &idx, double *vals, bool loaded = false) const;
 
     bool splitCheck(double prec, double splitFac, bool absPrec) const;
 
@@ -162,7 +167,6 @@ protected:
     double *coefs;
     int n_coefs;
 
-    int lockX;          // manual lock tag (avoiding omp set/unset)
     int serialIx;       // index in serial Tree
     int parentSerialIx; // index of parent in serial Tree, or -1 for roots
     int childSerialIx;  // index of first child in serial Tree, or -1 for leafnodes/endnodes
@@ -178,9 +182,13 @@ protected:
 
     virtual void allocCoefs(int n_blocks, int block_size);
     virtual void freeCoefs();
+    virtual void flagChildrenCreated();
 
     virtual double calcComponentNorm(int i) const;
 
+    void cvTransformCoefs(int kind, double *c, int scale) const;
+    void mwTransformCoefs(int kind, double *c) const;
+
     virtual void reCompress();
     virtual void giveChildrenCoefs(bool overwrite = true);
     virtual void copyCoefsFromChildren();
@@ -215,9 +223,10 @@ protected:
     static const unsigned char FlagEndNode = B8(00010000);
     static const unsigned char FlagRootNode = B8(00100000);
     static const unsigned char FlagLooseNode = B8(01000000);
+    static const unsigned char FlagGenerating = B8(10000000);
 
 private:
-    unsigned char status;
+    std::atomic<unsigned char> status;
 };
 
 /** Allocation status of s/d-coefs is stored in the status bits for
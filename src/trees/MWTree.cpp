@@ -29,9 +29,13 @@
  *
  */
 
+#include <unordered_set>
+
 #include "MWTree.h"
 #include "HilbertIterator.h"
 #include "MultiResolutionAnalysis.h"
+#include "NodeHashTable.h"
+#include "SerialTree.h"
 #include "utils/Printer.h"
 #include "utils/math_utils.h"
 #include "utils/periodic_utils.h"
@@ -52,7 +56,8 @@ MWTree<D>::MWTree(const MultiResolutionAnalysis<D> &mra)
         , name("nn")
         , nNodes(0)
         , squareNorm(-1.0)
-        , rootBox(mra.getWorldBox()) {
+        , rootBox(mra.getWorldBox())
+        , nodeHashTable(nullptr) {
     this->nodesAtDepth.push_back(0);
     allocNodeCounters();
 
@@ -64,6 +69,7 @@ MWTree<D>::MWTree(const MultiResolutionAnalysis<D> &mra)
 /** MWTree destructor. */
 template <int D> MWTree<D>::~MWTree() {
     this->endNodeTable.clear();
+    deleteNodeHashTable();
     if (this->nNodes != 0) MSG_ERROR("Node count != 0 -> " << this->nNodes);
     if (this->nodesAtDepth.size() != 1) MSG_ERROR("Nodes at depth != 1 -> " << this->nodesAtDepth.size());
     if (this->nodesAtDepth[0] != 0) MSG_ERROR("Nodes at depth 0 != 0 -> " << this->nodesAtDepth[0]);
@@ -123,6 +129,46 @@ template <int D> void MWTree<D>::mwTransformUp() {
     }
 }
 
+/** Bottom-up MW transform restricted to the given subtrees and the paths
+ * from their roots up to the root nodes. This can be used after a partial
+ * rebuild of the tree, when the coefficients of the rest of the tree are
+ * still valid. The subtrees must be disjoint. */
+template <int D> void MWTree<D>::mwTransformSubtrees(const MWNodeVector<D> &subRoots) {
+    std::vector<MWNodeVector<D>> nodeTable; // branch nodes to recompress, by depth
+    std::unordered_set<const MWNode<D> *> ancestors;
+    auto addNode = [&nodeTable](MWNode<D> *node) {
+        int depth = node->getDepth();
+        if (depth >= nodeTable.size()) nodeTable.resize(depth + 1);
+        nodeTable[depth].push_back(node);
+    };
+    for (auto *subRoot : subRoots) {
+        MWNodeVector<D> stack;
+        stack.push_back(subRoot);
+        while (stack.size() > 0) {
+            MWNode<D> *node = stack.back();
+            stack.pop_back();
+            if (node->isEndNode() or not node->isBranchNode()) continue;
+            addNode(node);
+            for (int i = 0; i < node->getTDim(); i++) stack.push_back(&node->getMWChild(i));
+        }
+        // paths to the root nodes are shared, stop at the first known ancestor
+        MWNode<D> *node = subRoot;
+        while (not node->isRootNode()) {
+            node = &node->getMWParent();
+            if (not ancestors.insert(node).second) break;
+            addNode(node);
+        }
+    }
+#pragma omp parallel shared(nodeTable)
+    {
+        for (int n = nodeTable.size() - 1; n >= 0; n--) {
+            int nNodes = nodeTable[n].size();
+#pragma omp for schedule(guided)
+            for (int i = 0; i < nNodes; i++) { nodeTable[n][i]->reCompress(); }
+        }
+    }
+}
+
 /** Regenerate all scaling coeffs by MW transformation of existing s/w-coeffs
  * on coarser scales, starting at the rootNodes. Option to overwrite or add up
  * existing scaling coefficients (can be used after operator application). */
@@ -253,6 +299,7 @@ template <int D> int MWTree<D>::getSizeNodes() const {
  * appropriate rootNode. */
 template <int D> const MWNode<D> *MWTree<D>::findNode(NodeIndex<D> idx) const {
     if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    if (hasNodeHashTable()) return this->nodeHashTable->find(idx);
     int rIdx = getRootBox().getBoxIndex(idx);
     if (rIdx < 0) return nullptr;
     const MWNode<D> &root = this->rootBox.getNode(rIdx);
@@ -268,6 +315,7 @@ template <int D> const MWNode<D> *MWTree<D>::findNode(NodeIndex<D> idx) const {
  * appropriate rootNode. */
 template <int D> MWNode<D> *MWTree<D>::findNode(NodeIndex<D> idx) {
     if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    if (hasNodeHashTable()) return this->nodeHashTable->find(idx);
     int rIdx = getRootBox().getBoxIndex(idx);
     if (rIdx < 0) return nullptr;
     MWNode<D> &root = this->rootBox.getNode(rIdx);
@@ -282,11 +330,36 @@ template <int D> MWNode<D> *MWTree<D>::findNode(NodeIndex<D> idx) {
  * decends from this.*/
 template <int D> MWNode<D> &MWTree<D>::getNode(NodeIndex<D> idx) {
     if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    if (hasNodeHashTable()) {
+        // start the descent from the closest existing ancestor
+        MWNode<D> *node = this->nodeHashTable->findClosest(idx, getRootScale());
+        if (node != nullptr) return *node->retrieveNode(idx);
+    }
     MWNode<D> &root = getRootBox().getNode(idx);
     assert(root.isAncestor(idx));
     return *root.retrieveNode(idx);
 }
 
+/** Find and return the node with the given NodeIndex.
+ *
+ * Same as getNode(idx), but the search starts at a node of this tree that is
+ * close to the requested one. We climb from this node to the closest common
+ * ancestor and descend from there, which is much shorter than a descent from
+ * the root for neighbouring nodes at fine scales. */
+template <int D> MWNode<D> &MWTree<D>::getNode(NodeIndex<D> idx, MWNode<D> &near) {
+    if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    if (hasNodeHashTable()) {
+        MWNode<D> *node = this->nodeHashTable->find(idx);
+        if (node != nullptr) return *node;
+    }
+    MWNode<D> *node = &near;
+    while (not node->isAncestor(idx)) {
+        if (node->parent == nullptr) return getNode(idx);
+        node = node->parent;
+    }
+    return *node->retrieveNode(idx);
+}
+
 /** Find and return the node with the given NodeIndex.
  *
  * This routine returns the ProjectedNode you ask for, or the EndNode on
@@ -294,6 +367,11 @@ template <int D> MWNode<D> &MWTree<D>::getNode(NodeIndex<D> idx) {
  * Recursion starts at the appropriate rootNode and decends from this. */
 template <int D> MWNode<D> &MWTree<D>::getNodeOrEndNode(NodeIndex<D> idx) {
     if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    if (hasNodeHashTable()) {
+        // the closest existing ancestor is either the node itself or the EndNode on the path
+        MWNode<D> *node = this->nodeHashTable->findClosest(idx, getRootScale());
+        if (node != nullptr) return *node;
+    }
     MWNode<D> &root = getRootBox().getNode(idx);
     assert(root.isAncestor(idx));
     return *root.retrieveNodeOrEndNode(idx);
@@ -306,11 +384,35 @@ template <int D> MWNode<D> &MWTree<D>::getNodeOrEndNode(NodeIndex<D> idx) {
  * Recursion starts at the appropriate rootNode and decends from this. */
 template <int D> const MWNode<D> &MWTree<D>::getNodeOrEndNode(NodeIndex<D> idx) const {
     if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    if (hasNodeHashTable()) {
+        // the closest existing ancestor is either the node itself or the EndNode on the path
+        const MWNode<D> *node = this->nodeHashTable->findClosest(idx, getRootScale());
+        if (node != nullptr) return *node;
+    }
     const MWNode<D> &root = getRootBox().getNode(idx);
     assert(root.isAncestor(idx));
     return *root.retrieveNodeOrEndNode(idx);
 }
 
+/** Compressed coefs of the node with the given NodeIndex.
+ *
+ * This routine never creates nodes. If the node is finer than the tree, its
+ * coefs are computed on the fly from the EndNode on the path to the node, see
+ * MWNode::calcDescendantCoefs. The vector c must hold 2^D * (k+1)^D values.
+ * No memory is allocated and the tree is not modified, so this can be called
+ * concurrently from several threads. */
+template <int D> void MWTree<D>::getNodeCoefs(NodeIndex<D> idx, double *c) const {
+    if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    getNodeOrEndNode(idx).calcDescendantCoefs(idx, c);
+}
+
+/** Function values in the quadrature points of the children of the node
+ * with the given NodeIndex. Like getNodeCoefs, this never creates nodes. */
+template <int D> void MWTree<D>::getNodeValues(NodeIndex<D> idx, double *vals) const {
+    if (getRootBox().isPeriodic()) { periodic::indx_manipulation<D>(idx, getRootBox().getPeriodic()); }
+    getNodeOrEndNode(idx).calcDescendantValues(idx, vals);
+}
+
 /** Find and return the node at a given depth that contains a given coordinate.
  *
  * This routine ALWAYS returns the node you ask for, and will generate nodes
@@ -395,6 +497,42 @@ template <int D> void MWTree<D>::resetEndNodeTable() {
     }
 }
 
+/** Create the children of all nodes in the vector, same as calling
+ * createChildren() on each of them. The memory is reserved in the order of
+ * the vector, while the children are constructed in parallel. Must be called
+ * outside of a parallel region. */
+template <int D> void MWTree<D>::createChildren(MWNodeVector<D> &parents) {
+    for (auto *node : parents) {
+        if (node->isBranchNode()) MSG_ABORT("Node already has children");
+    }
+    this->serialTree_p->allocChildren(parents);
+    for (auto *node : parents) {
+        node->flagChildrenCreated();
+        if (this->nodeHashTable != nullptr) {
+            for (int cIdx = 0; cIdx < node->getTDim(); cIdx++) this->nodeHashTable->insert(node->children[cIdx]);
+        }
+    }
+}
+
+/** Build the hash table for constant time lookup of nodes by NodeIndex.
+ *
+ * Once built, the table is used by findNode, getNode and getNodeOrEndNode
+ * (NodeIndex versions) and is kept up to date as nodes are created or deleted.
+ * Note that node creation is not thread safe while the table is active. */
+template <int D> void MWTree<D>::makeNodeHashTable() {
+    if (this->nodeHashTable == nullptr) this->nodeHashTable = new NodeHashTable<D>(getNNodes());
+    this->nodeHashTable->clear();
+    HilbertIterator<D> it(this);
+    it.setReturnGenNodes(false);
+    while (it.next()) this->nodeHashTable->insert(&it.getNode());
+}
+
+/** Remove the NodeIndex hash table, lookups go back to descending from the root. */
+template <int D> void MWTree<D>::deleteNodeHashTable() {
+    if (this->nodeHashTable != nullptr) delete this->nodeHashTable;
+    this->nodeHashTable = nullptr;
+}
+
 template <int D> int MWTree<D>::countBranchNodes(int depth) {
     NOT_IMPLEMENTED_ABORT;
 }
@@ -54,8 +54,15 @@ public:
 
     void setZero();
 
-    /** @returns Squared L2 norm of the function */
-    double getSquareNorm() const { return this->squareNorm; }
+    /** @returns Squared L2 norm of the function. The norm is updated
+     * atomically by the tasks of TreeBuilder::buildTasks while they call
+     * splitCheck, so it is read atomically as well. */
+    double getSquareNorm() const {
+        double sqNorm;
+#pragma omp atomic read
+        sqNorm = this->squareNorm;
+        return sqNorm;
+    }
     void calcSquareNorm();
     void clearSquareNorm() { this->squareNorm = -1.0; }
 
@@ -76,6 +83,7 @@ public:
     const MultiResolutionAnalysis<D> &getMRA() const { return this->MRA; }
 
     void mwTransform(int type, bool overwrite = true);
+    void mwTransformSubtrees(const MWNodeVector<D> &subRoots);
 
     void setName(const std::string &n) { this->name = n; }
     const std::string &getName() const { return this->name; }
@@ -87,8 +95,11 @@ public:
     const MWNode<D> *findNode(NodeIndex<D> nIdx) const;
 
     MWNode<D> &getNode(NodeIndex<D> nIdx);
+    MWNode<D> &getNode(NodeIndex<D> nIdx, MWNode<D> &near);
     MWNode<D> &getNodeOrEndNode(NodeIndex<D> nIdx);
     const MWNode<D> &getNodeOrEndNode(NodeIndex<D> nIdx) const;
+    virtual void getNodeCoefs(NodeIndex<D> nIdx, double *c) const;
+    virtual void getNodeValues(NodeIndex<D> nIdx, double *vals) const;
 
     MWNode<D> &getNode(const Coord<D> &r, int depth = -1);
     MWNode<D> &getNodeOrEndNode(Coord<D> r, int depth = -1);
@@ -109,6 +120,11 @@ public:
     void resetEndNodeTable();
     void clearEndNodeTable() { this->endNodeTable.clear(); }
 
+    void makeNodeHashTable();
+    void deleteNodeHashTable();
+    bool hasNodeHashTable() const { return (this->nodeHashTable != nullptr); }
+
+    void createChildren(MWNodeVector<D> &parents);
     void deleteGenerated();
 
     int getNThreads() const { return this->nThreads; }
@@ -159,6 +175,7 @@ protected:
     NodeBox<D> rootBox;            ///< The actual container of nodes
     MWNodeVector<D> endNodeTable;  ///< Final projected nodes
     std::vector<int> nodesAtDepth; ///< Node counter
+    NodeHashTable<D> *nodeHashTable; ///< Optional (scale, translation) lookup of nodes
 
     virtual void mwTransformDown(bool overwrite);
     virtual void mwTransformUp();
@@ -0,0 +1,137 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#include "NodeHashTable.h"
+#include "MWNode.h"
+#include "utils/Printer.h"
+
+namespace mrcpp {
+
+/** NodeHashTable constructor.
+ * Reserves space for nNodes nodes, the table grows automatically. */
+template <int D> NodeHashTable<D>::NodeHashTable(int nNodes) {
+    int capacity = 64;
+    while (capacity < 2 * nNodes) capacity *= 2;
+    this->entries.resize(capacity);
+}
+
+/** Pack scale and translation into a single 64 bit hash (splitmix64 mixing). */
+template <int D> uint64_t NodeHashTable<D>::hash(const NodeIndex<D> &idx) const {
+    uint64_t h = static_cast<uint64_t>(idx.getScale() + 1024);
+    for (int d = 0; d < D; d++) {
+        h = h * 0x100000001b3ULL + static_cast<uint32_t>(idx.getTranslation(d));
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+    }
+    return h;
+}
+
+/** Add a node to the table, the node must not already be present. */
+template <int D> void NodeHashTable<D>::insert(MWNode<D> *node) {
+    if (2 * (this->nEntries + this->nTombstones + 1) > this->entries.size()) {
+        // grow only if the table is actually filling up, otherwise just clean out tombstones
+        int capacity = this->entries.size();
+        if (4 * (this->nEntries + 1) > capacity) capacity *= 2;
+        rehash(capacity);
+    }
+    const NodeIndex<D> &idx = node->getNodeIndex();
+    uint64_t mask = this->entries.size() - 1;
+    uint64_t i = hash(idx) & mask;
+    while (this->entries[i].node != nullptr) {
+        assert(this->entries[i].idx != idx);
+        i = (i + 1) & mask;
+    }
+    if (this->entries[i].removed) this->nTombstones--;
+    this->entries[i].idx = idx;
+    this->entries[i].node = node;
+    this->entries[i].removed = false;
+    this->nEntries++;
+}
+
+/** Remove a node from the table, if present. */
+template <int D> void NodeHashTable<D>::remove(const NodeIndex<D> &idx) {
+    uint64_t mask = this->entries.size() - 1;
+    uint64_t i = hash(idx) & mask;
+    while (this->entries[i].node != nullptr or this->entries[i].removed) {
+        if (this->entries[i].node != nullptr and this->entries[i].idx == idx) {
+            this->entries[i].node = nullptr;
+            this->entries[i].removed = true;
+            this->nEntries--;
+            this->nTombstones++;
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+template <int D> void NodeHashTable<D>::clear() {
+    for (auto &entry : this->entries) entry = Entry();
+    this->nEntries = 0;
+    this->nTombstones = 0;
+}
+
+/** @returns Node with the given index, or NULL pointer if not present */
+template <int D> MWNode<D> *NodeHashTable<D>::find(const NodeIndex<D> &idx) const {
+    uint64_t mask = this->entries.size() - 1;
+    uint64_t i = hash(idx) & mask;
+    while (this->entries[i].node != nullptr or this->entries[i].removed) {
+        if (this->entries[i].node != nullptr and this->entries[i].idx == idx) return this->entries[i].node;
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+/** @returns The node with the given index or, if it does not exist, its
+ * closest existing ancestor. NULL pointer if no ancestor is found above
+ * rootScale. */
+template <int D> MWNode<D> *NodeHashTable<D>::findClosest(NodeIndex<D> idx, int rootScale) const {
+    while (idx.getScale() >= rootScale) {
+        MWNode<D> *node = find(idx);
+        if (node != nullptr) return node;
+        int *l = idx.getTranslation();
+        for (int d = 0; d < D; d++) l[d] = (l[d] < 0) ? (l[d] - 1) / 2 : l[d] / 2; // floor(l/2)
+        idx.setScale(idx.getScale() - 1);
+    }
+    return nullptr;
+}
+
+template <int D> void NodeHashTable<D>::rehash(int capacity) {
+    std::vector<Entry> old(capacity);
+    old.swap(this->entries);
+    this->nEntries = 0;
+    this->nTombstones = 0;
+    for (auto &entry : old) {
+        if (entry.node != nullptr) insert(entry.node);
+    }
+}
+
+template class NodeHashTable<1>;
+template class NodeHashTable<2>;
+template class NodeHashTable<3>;
+
+} // namespace mrcpp
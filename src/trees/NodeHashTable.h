@@ -0,0 +1,74 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+/**
+ *  Hash table for constant time lookup of the nodes of a tree.
+ *
+ *  Open addressing with linear probing. The key is the (scale, translation)
+ *  of the node, and only ProjectedNodes are stored, i.e. the table contains
+ *  the same nodes as a traversal of the tree without GenNodes.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MRCPP/mrcpp_declarations.h"
+#include "NodeIndex.h"
+
+namespace mrcpp {
+
+template <int D> class NodeHashTable final {
+public:
+    NodeHashTable(int nNodes = 0);
+    NodeHashTable(const NodeHashTable<D> &table) = delete;
+    NodeHashTable<D> &operator=(const NodeHashTable<D> &table) = delete;
+
+    void insert(MWNode<D> *node);
+    void remove(const NodeIndex<D> &idx);
+    void clear();
+
+    MWNode<D> *find(const NodeIndex<D> &idx) const;
+    MWNode<D> *findClosest(NodeIndex<D> idx, int rootScale) const;
+
+    int size() const { return this->nEntries; }
+
+private:
+    struct Entry {
+        NodeIndex<D> idx;
+        MWNode<D> *node{nullptr};
+        bool removed{false}; // tombstone, keeps the probe sequence intact
+    };
+
+    int nEntries{0};    // number of nodes in the table
+    int nTombstones{0}; // number of removed entries still occupying a slot
+    std::vector<Entry> entries;
+
+    uint64_t hash(const NodeIndex<D> &idx) const;
+    void rehash(int capacity);
+};
+
+} // namespace mrcpp
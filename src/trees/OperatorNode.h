@@ -40,10 +40,6 @@ public:
     const OperatorNode &getOperParent() const { return static_cast<const OperatorNode &>(*this->parent); }
     const OperatorNode &getOperChild(int i) const { return static_cast<const OperatorNode &>(*this->children[i]); }
 
-    void createChildren() override {
-        MWNode<2>::createChildren();
-        this->clearIsEndNode();
-    }
     void genChildren() override {
         MWNode<2>::createChildren();
         this->clearIsEndNode();
@@ -66,6 +62,10 @@ protected:
 
     void dealloc() override;
     double calcComponentNorm(int i) const override;
+    void flagChildrenCreated() override {
+        MWNode<2>::flagChildrenCreated();
+        this->clearIsEndNode();
+    }
 };
 
 } // namespace mrcpp
@@ -23,6 +23,10 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
 #include "OperatorTree.h"
 #include "BandWidth.h"
 #include "LebesgueIterator.h"
@@ -30,6 +34,7 @@
 #include "SerialOperatorTree.h"
 #include "SerialTree.h"
 #include "utils/Printer.h"
+#include "utils/Timer.h"
 
 using namespace Eigen;
 
@@ -198,6 +203,144 @@ void OperatorTree::mwTransformDown(bool overwrite) {
     }
 }
 
+static const int oper_tree_version = 2;
+
+/** @brief Write the operator tree to disk, for later use
+ * @param[in] file: File name, will get ".tree" extension
+ *
+ * @details Node norms are stored with the coefficients, so the expensive
+ * operator norms are not recomputed on load. The node pointer cache and the
+ * band width are not stored, they are set up again by the reader.
+ */
+void OperatorTree::saveTree(const std::string &file) {
+    Timer t1;
+    std::stringstream fname;
+    fname << file << ".tree";
+
+    std::fstream f;
+    f.open(fname.str(), std::ios::out | std::ios::binary);
+    if (not f.is_open()) MSG_ERROR("Unable to open file");
+    saveTree(f);
+    f.close();
+    print::time(10, "Time write", t1);
+}
+
+/** @brief Read a previously stored operator tree from disk
+ * @param[in] file: File name, will get ".tree" extension
+ * @note This tree must have the exact same MRA the one that was saved
+ */
+void OperatorTree::loadTree(const std::string &file) {
+    Timer t1;
+    std::stringstream fname;
+    fname << file << ".tree";
+
+    std::fstream f;
+    f.open(fname.str(), std::ios::in | std::ios::binary);
+    if (not f.is_open()) MSG_ERROR("Unable to open file");
+    loadTree(f);
+    f.close();
+    print::time(10, "Time read tree", t1);
+}
+
+/** @brief Write the operator tree record to an open binary stream */
+void OperatorTree::saveTree(std::ostream &f) {
+    std::vector<MWNode<2> *> nodes;
+    for (int i = 0; i < this->rootBox.size(); i++) nodes.push_back(&this->getRootMWNode(i));
+    for (int n = 0; n < nodes.size(); n++) {
+        if (nodes[n]->isBranchNode()) {
+            for (int i = 0; i < nodes[n]->getTDim(); i++) nodes.push_back(&nodes[n]->getMWChild(i));
+        }
+    }
+    int nNodes = nodes.size();
+    int nCoefs = nodes[0]->getNCoefs();
+
+    const BoundingBox<2> &box = getMRA().getWorldBox();
+    OperatorTreeHeader header{};
+    std::copy_n("MROT", 4, header.magic);
+    header.version = oper_tree_version;
+    header.scalingType = getMRA().getScalingBasis().getScalingType();
+    header.scalingOrder = getMRA().getScalingBasis().getScalingOrder();
+    header.rootScale = getRootScale();
+    header.nRoots = this->rootBox.size();
+    header.nNodes = nNodes;
+    header.nCoefs = nCoefs;
+    for (int d = 0; d < 2; d++) {
+        header.corner[d] = box.getCornerIndex().getTranslation(d);
+        header.nBoxes[d] = box.size(d);
+        header.scaling[d] = box.getScalingFactor(d);
+    }
+    header.normPrec = this->normPrec;
+    header.squareNorm = this->squareNorm;
+    f.write((char *)&header, sizeof(OperatorTreeHeader));
+
+    std::vector<unsigned char> flags(8 * ((nNodes + 7) / 8), 0);
+    std::vector<double> norms(5 * nNodes);
+    for (int n = 0; n < nNodes; n++) {
+        if (nodes[n]->isBranchNode()) flags[n] = 1;
+        norms[5 * n] = nodes[n]->getSquareNorm();
+        for (int i = 0; i < 4; i++) norms[5 * n + 1 + i] = nodes[n]->getComponentNorm(i);
+    }
+    f.write((char *)flags.data(), flags.size() * sizeof(unsigned char));
+    f.write((char *)norms.data(), norms.size() * sizeof(double));
+    for (auto &node : nodes) f.write((char *)node->getCoefs(), nCoefs * sizeof(double));
+}
+
+/** @brief Read an operator tree record from an open binary stream
+ *
+ * @details The tree must be empty, i.e. consist of its root nodes only. The
+ * node pointer cache is set up after reading.
+ */
+void OperatorTree::loadTree(std::istream &f) {
+    if (getNNodes() != this->rootBox.size()) MSG_ABORT("Operator tree not empty");
+
+    OperatorTreeHeader header{};
+    f.read((char *)&header, sizeof(OperatorTreeHeader));
+    if (not f or std::string(header.magic, 4) != "MROT") MSG_ABORT("Invalid operator tree file");
+    if (header.version != oper_tree_version) MSG_ABORT("Unsupported operator tree version " << header.version);
+    const BoundingBox<2> &box = getMRA().getWorldBox();
+    bool sameBox = true;
+    for (int d = 0; d < 2; d++) {
+        if (header.corner[d] != box.getCornerIndex().getTranslation(d) or header.nBoxes[d] != box.size(d) or
+            header.scaling[d] != box.getScalingFactor(d)) {
+            sameBox = false;
+        }
+    }
+    if (header.scalingType != getMRA().getScalingBasis().getScalingType() or
+        header.scalingOrder != getMRA().getScalingBasis().getScalingOrder() or header.rootScale != getRootScale() or
+        header.nRoots != this->rootBox.size() or header.normPrec != this->normPrec or not sameBox) {
+        MSG_ABORT("Operator tree file does not match the MRA");
+    }
+    int nNodes = header.nNodes;
+    int nCoefs = header.nCoefs;
+
+    std::vector<unsigned char> flags(8 * ((nNodes + 7) / 8));
+    std::vector<double> norms(5 * nNodes);
+    f.read((char *)flags.data(), flags.size() * sizeof(unsigned char));
+    f.read((char *)norms.data(), norms.size() * sizeof(double));
+
+    // Recreate the nodes in the order they were stored
+    std::vector<MWNode<2> *> nodes;
+    for (int i = 0; i < this->rootBox.size(); i++) nodes.push_back(&this->getRootMWNode(i));
+    for (int n = 0; n < nNodes; n++) {
+        if (n >= nodes.size()) MSG_ABORT("Corrupt operator tree file");
+        MWNode<2> &node = *nodes[n];
+        if (node.getNCoefs() != nCoefs) MSG_ABORT("Operator tree file does not match the MRA");
+        if (flags[n] == 1) {
+            node.createChildren();
+            for (int i = 0; i < node.getTDim(); i++) nodes.push_back(&node.getMWChild(i));
+        }
+        f.read((char *)node.getCoefs(), nCoefs * sizeof(double));
+        node.squareNorm = norms[5 * n];
+        for (int i = 0; i < 4; i++) node.componentNorms[i] = norms[5 * n + 1 + i];
+        node.setHasCoefs();
+    }
+    if (not f or nodes.size() != nNodes) MSG_ABORT("Corrupt operator tree file");
+
+    this->resetEndNodeTable();
+    this->squareNorm = header.squareNorm;
+    this->setupOperNodeCache();
+}
+
 std::ostream &OperatorTree::print(std::ostream &o) {
     o << std::endl << "*OperatorTree: " << this->name << std::endl;
     return MWTree<2>::print(o);
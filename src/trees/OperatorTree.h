@@ -25,10 +25,35 @@
 
 #pragma once
 
+#include <iostream>
+
 #include "MWTree.h"
 
 namespace mrcpp {
 
+/** File layout of a stored OperatorTree, version 2. All sections start at
+ * multiples of 8 bytes from the start of the record, so that the norms and
+ * coefficients can be used in place from a memory mapped file. Nodes are
+ * stored in breadth-first order, starting with the root nodes. */
+struct OperatorTreeHeader {
+    char magic[4];       // "MROT"
+    int version;         // file format version
+    int scalingType;     // Interpol or Legendre
+    int scalingOrder;    // polynomial order of the basis
+    int rootScale;       // scale of the root nodes
+    int nRoots;          // number of root nodes
+    int nNodes;          // total number of nodes
+    int nCoefs;          // coefficients per node, all four components
+    int corner[2];       // translation of the corner of the world box
+    int nBoxes[2];       // root boxes in each direction of the world box
+    double normPrec;     // precision of the operator norms
+    double squareNorm;   // square norm of the tree
+    double scaling[2];   // scaling factor of the world box in each direction
+    // unsigned char flags[nNodes], padded to a multiple of 8, branch nodes are 1
+    // double norms[nNodes][5], squareNorm followed by the four componentNorms
+    // double coefs[nNodes][nCoefs]
+};
+
 class OperatorTree final : public MWTree<2> {
 public:
     OperatorTree(const MultiResolutionAnalysis<2> &mra, double np);
@@ -53,6 +78,11 @@ public:
     void mwTransformDown(bool overwrite) override;
     void mwTransformUp() override;
 
+    void saveTree(const std::string &file) override;
+    void loadTree(const std::string &file) override;
+    void saveTree(std::ostream &f);
+    void loadTree(std::istream &f);
+
 protected:
     const double normPrec;
     BandWidth *bandWidth;
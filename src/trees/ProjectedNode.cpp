@@ -31,8 +31,8 @@ using namespace Eigen;
 
 namespace mrcpp {
 
-template <int D> void ProjectedNode<D>::createChildren() {
-    MWNode<D>::createChildren();
+template <int D> void ProjectedNode<D>::flagChildrenCreated() {
+    MWNode<D>::flagChildrenCreated();
     this->clearIsEndNode();
 }
 
@@ -31,7 +31,6 @@ namespace mrcpp {
 
 template <int D> class ProjectedNode final : public FunctionNode<D> {
 public:
-    void createChildren() override;
     void genChildren() override;
     void deleteChildren() override;
 
@@ -46,6 +45,7 @@ protected:
 
     void dealloc() override;
     void reCompress() override;
+    void flagChildrenCreated() override;
 };
 
 } // namespace mrcpp
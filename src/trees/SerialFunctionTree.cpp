@@ -23,12 +23,18 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <algorithm>
+#include <iomanip>
+#include <new>
+
 #include "SerialFunctionTree.h"
+#include "ChunkPool.h"
 #include "FunctionTree.h"
 #include "GenNode.h"
 #include "ProjectedNode.h"
 #include "utils/Printer.h"
 #include "utils/mpi_utils.h"
+#include "utils/numa_utils.h"
 
 namespace mrcpp {
 
@@ -47,8 +53,11 @@ template <int D>
 SerialFunctionTree<D>::SerialFunctionTree(FunctionTree<D> *tree, SharedMemory *mem)
         : SerialTree<D>(tree, mem)
         , nGenNodes(0)
+        , maxGenNodes(0)
+        , hugePages(false)
+        , singlePrecision(false)
         , lastNode(nullptr)
-        , lastGenNode(nullptr) {
+        , genNodeArenas(tree->getNThreads()) {
 
     // Size for GenNodes chunks. ProjectedNodes will be 8 times larger
     this->sizeGenNodeCoeff = this->tree_p->getKp1_d();       // One block
@@ -69,16 +78,6 @@ SerialFunctionTree<D>::SerialFunctionTree(FunctionTree<D> *tree, SharedMemory *m
 
     this->lastNode = // position just after last allocated node, i.e. where to put next node
         static_cast<ProjectedNode<D> *>(this->sNodes);
-    this->lastGenNode = this->sGenNodes; // position just after last allocated Gen node, i.e. where to put next node
-
-    // make virtual table pointers
-    auto *tmpNode = new ProjectedNode<D>();
-    this->cvptr_ProjectedNode = *(char **)(tmpNode);
-    delete tmpNode;
-
-    auto *tmpGenNode = new GenNode<D>();
-    this->cvptr_GenNode = *(char **)(tmpGenNode);
-    delete tmpGenNode;
 
 #ifdef _OPENMP
     omp_init_lock(&Sfunc_tree_lock);
@@ -87,14 +86,11 @@ SerialFunctionTree<D>::SerialFunctionTree(FunctionTree<D> *tree, SharedMemory *m
 
 /** SerialTree destructor. */
 template <int D> SerialFunctionTree<D>::~SerialFunctionTree() {
-    for (int i = 0; i < this->genNodeCoeffChunks.size(); i++) delete[] this->genNodeCoeffChunks[i];
-    for (int i = 0; i < this->nodeChunks.size(); i++) delete[](char *)(this->nodeChunks[i]);
-    if (not this->isShared()) // if the data is shared, it must be freed by MPI_Win_free
-        for (int i = 0; i < this->nodeCoeffChunks.size(); i++) delete[] this->nodeCoeffChunks[i];
-    for (int i = 0; i < this->genNodeChunks.size(); i++) delete[](char *)(this->genNodeChunks[i]);
+    for (int i = 0; i < this->nodeChunks.size(); i++) this->freeChunk(i);
+    for (auto &chunk : this->nodeCoeffChunksSP) delete[] chunk;
+    this->deallocGenNodeChunks();
 
     this->nodeStackStatus.clear();
-    this->genNodeStackStatus.clear();
 
 #ifdef _OPENMP
     omp_destroy_lock(&Sfunc_tree_lock);
@@ -118,7 +114,7 @@ template <int D> void SerialFunctionTree<D>::allocRoots(MWTree<D> &tree) {
     for (int rIdx = 0; rIdx < nRoots; rIdx++) {
         roots[rIdx] = root_p;
 
-        *(char **)(root_p) = this->cvptr_ProjectedNode;
+        new (root_p) ProjectedNode<D>();
 
         root_p->tree = &tree;
         root_p->parent = nullptr;
@@ -130,7 +126,6 @@ template <int D> void SerialFunctionTree<D>::allocRoots(MWTree<D> &tree) {
         root_p->n_coefs = this->sizeNodeCoeff;
         root_p->coefs = coefs_p;
 
-        root_p->lockX = 0;
         root_p->serialIx = sIx;
         root_p->parentSerialIx = -1; // to indicate rootnode
         root_p->childSerialIx = -1;
@@ -159,13 +154,38 @@ template <int D> void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
     // all children must be generated at once if several threads are active
     int nChildren = parent.getTDim();
     ProjectedNode<D> *child_p = this->allocNodes(nChildren, &sIx, &coefs_p);
+    for (int cIdx = 0; cIdx < nChildren; cIdx++) this->tree_p->incrementNodeCount(parent.getScale() + 1);
+
+    initChildren(parent, child_p, sIx, coefs_p);
+}
+
+/** Allocate the children of all nodes in the vector. The memory is reserved
+ * serially in the order of the vector, so the node layout is the same as with
+ * repeated calls to allocChildren(parent), while the children are constructed
+ * in parallel. */
+template <int D> void SerialFunctionTree<D>::allocChildren(MWNodeVector<D> &parents) {
+    int nParents = parents.size();
+    int nChildren = 1 << D;
+    std::vector<ProjectedNode<D> *> child_p(nParents);
+    std::vector<double *> coefs_p(nParents);
+    std::vector<int> sIx(nParents);
+    for (int n = 0; n < nParents; n++) {
+        child_p[n] = this->allocNodes(nChildren, &sIx[n], &coefs_p[n]);
+        for (int cIdx = 0; cIdx < nChildren; cIdx++) this->tree_p->incrementNodeCount(parents[n]->getScale() + 1);
+    }
+#pragma omp parallel for schedule(static) if (nParents > 64)
+    for (int n = 0; n < nParents; n++) initChildren(*parents[n], child_p[n], sIx[n], coefs_p[n]);
+}
 
+/** Construct the children of parent in the nodes that were reserved by allocNodes */
+template <int D>
+void SerialFunctionTree<D>::initChildren(MWNode<D> &parent, ProjectedNode<D> *child_p, int sIx, double *coefs_p) {
     // position of first child
     parent.childSerialIx = sIx;
-    for (int cIdx = 0; cIdx < nChildren; cIdx++) {
+    for (int cIdx = 0; cIdx < parent.getTDim(); cIdx++) {
         parent.children[cIdx] = child_p;
 
-        *(char **)(child_p) = this->cvptr_ProjectedNode;
+        new (child_p) ProjectedNode<D>();
 
         child_p->tree = parent.tree;
         child_p->parent = &parent;
@@ -177,7 +197,6 @@ template <int D> void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
         child_p->n_coefs = this->sizeNodeCoeff;
         child_p->coefs = coefs_p;
 
-        child_p->lockX = 0;
         child_p->serialIx = sIx;
         child_p->parentSerialIx = parent.serialIx;
         child_p->childSerialIx = -1;
@@ -190,8 +209,6 @@ template <int D> void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
         child_p->clearHasCoefs();
         child_p->setIsEndNode();
 
-        child_p->tree->incrementNodeCount(child_p->getScale());
-
         sIx++;
         child_p++;
         coefs_p += this->sizeNodeCoeff;
@@ -199,6 +216,7 @@ template <int D> void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
 }
 
 template <int D> void SerialFunctionTree<D>::allocGenChildren(MWNode<D> &parent) {
+    if (this->singlePrecision) MSG_ABORT("Tree is stored in single precision");
     int sIx;
     double *coefs_p;
     // NB: serial tree MUST generate all children consecutively
@@ -211,7 +229,7 @@ template <int D> void SerialFunctionTree<D>::allocGenChildren(MWNode<D> &parent)
     for (int cIdx = 0; cIdx < nChildren; cIdx++) {
         parent.children[cIdx] = child_p;
 
-        *(char **)(child_p) = this->cvptr_GenNode;
+        new (child_p) GenNode<D>();
 
         child_p->tree = parent.tree;
         child_p->parent = &parent;
@@ -223,7 +241,6 @@ template <int D> void SerialFunctionTree<D>::allocGenChildren(MWNode<D> &parent)
         child_p->n_coefs = this->sizeGenNodeCoeff;
         child_p->coefs = coefs_p;
 
-        child_p->lockX = 0;
         child_p->serialIx = sIx;
         child_p->parentSerialIx = parent.serialIx;
         child_p->childSerialIx = -1;
@@ -244,8 +261,42 @@ template <int D> void SerialFunctionTree<D>::allocGenChildren(MWNode<D> &parent)
     }
 }
 
+/** Add one (empty) chunk of ProjectedNodes and coefficients at the end of the stack */
+template <int D> void SerialFunctionTree<D>::appendChunk() {
+    double *sNodesCoeff;
+    char *sNodesChunk = nullptr;
+    if (this->isShared()) {
+        // for coefficients, take from the shared memory block
+        sNodesCoeff = this->shMem->sh_end_ptr;
+        this->shMem->sh_end_ptr += (this->sizeNodeCoeff * this->maxNodesPerChunk);
+        // may increase size dynamically in the future
+        if (this->shMem->sh_max_ptr < this->shMem->sh_end_ptr) MSG_ABORT("Shared block too small");
+    } else if (this->hugePages or not ChunkPool::pop(D, this->sizeGenNodeCoeff, &sNodesChunk, &sNodesCoeff)) {
+        // fresh pages, first touched by the threads computing the nodes
+        sNodesCoeff = numa_utils::alloc_chunk(this->sizeNodeCoeff * this->maxNodesPerChunk, this->hugePages);
+    }
+    if (sNodesChunk == nullptr) sNodesChunk = new char[this->maxNodesPerChunk * sizeof(ProjectedNode<D>)];
+
+    this->nodeCoeffChunks.push_back(sNodesCoeff);
+    this->nodeCoeffChunkHuge.push_back(this->hugePages);
+    this->sNodes = (ProjectedNode<D> *)sNodesChunk;
+    for (int i = 0; i < this->maxNodesPerChunk; i++) {
+        this->sNodes[i].serialIx = -1;
+        this->sNodes[i].parentSerialIx = -1;
+        this->sNodes[i].childSerialIx = -1;
+    }
+    this->nodeChunks.push_back(this->sNodes);
+
+    // allocate new chunk in nodeStackStatus
+    int oldsize = this->nodeStackStatus.size();
+    int newsize = oldsize + this->maxNodesPerChunk;
+    for (int i = oldsize; i < newsize; i++) this->nodeStackStatus.push_back(0);
+    this->maxNodes = newsize;
+}
+
 // return pointer to the last active node or NULL if failed
 template <int D> ProjectedNode<D> *SerialFunctionTree<D>::allocNodes(int nAlloc, int *serialIx, double **coefs_p) {
+    if (this->singlePrecision) MSG_ABORT("Tree is stored in single precision");
     *serialIx = this->nNodes;
     int chunkIx = *serialIx % (this->maxNodesPerChunk);
 
@@ -260,31 +311,7 @@ template <int D> ProjectedNode<D> *SerialFunctionTree<D>::allocNodes(int nAlloc,
         // careful: nodeChunks.size() is an unsigned int
         if (chunk + 1 > this->nodeChunks.size()) {
             // need to allocate new chunk
-            double *sNodesCoeff;
-            if (this->isShared()) {
-                // for coefficients, take from the shared memory block
-                sNodesCoeff = this->shMem->sh_end_ptr;
-                this->shMem->sh_end_ptr += (this->sizeNodeCoeff * this->maxNodesPerChunk);
-                // may increase size dynamically in the future
-                if (this->shMem->sh_max_ptr < this->shMem->sh_end_ptr) MSG_ABORT("Shared block too small");
-            } else {
-                sNodesCoeff = new double[this->sizeNodeCoeff * this->maxNodesPerChunk];
-            }
-
-            this->nodeCoeffChunks.push_back(sNodesCoeff);
-            this->sNodes = (ProjectedNode<D> *)new char[this->maxNodesPerChunk * sizeof(ProjectedNode<D>)];
-            for (int i = 0; i < this->maxNodesPerChunk; i++) {
-                this->sNodes[i].serialIx = -1;
-                this->sNodes[i].parentSerialIx = -1;
-                this->sNodes[i].childSerialIx = -1;
-            }
-            this->nodeChunks.push_back(this->sNodes);
-
-            // allocate new chunk in nodeStackStatus
-            int oldsize = this->nodeStackStatus.size();
-            int newsize = oldsize + this->maxNodesPerChunk;
-            for (int i = oldsize; i < newsize; i++) this->nodeStackStatus.push_back(0);
-            this->maxNodes = newsize;
+            this->appendChunk();
 
             if (chunk % 100 == 99 and D == 3)
                 println(10,
@@ -338,6 +365,7 @@ template <int D> void SerialFunctionTree<D>::deallocNodes(int serialIx) {
 
 /** Fill all holes in the chunks with occupied nodes, then remove all empty chunks */
 template <int D> int SerialFunctionTree<D>::shrinkChunks() {
+    if (this->singlePrecision) MSG_ABORT("Tree is stored in single precision");
     int nAlloc = (1 << D);
     if (this->maxNodesPerChunk * this->nodeChunks.size() <=
         this->getTree()->getNNodes() + this->maxNodesPerChunk + nAlloc - 1) {
@@ -425,206 +453,617 @@ template <int D> int SerialFunctionTree<D>::shrinkChunks() {
     this->lastNode = this->nodeChunks[ichunk] + inode;
 
     int nChunks = posocc / this->maxNodesPerChunk + 1; // number of occupied chunks
-    for (int i = nChunks; i < this->nodeChunks.size(); i++)
-        delete[](char *)(this->nodeChunks[i]); // remove unused chunks
-
     // Note that shared coefficients cannot be deallocated, but it is still useful to shrink the holes.
-    if (not this->isShared()) // if the data is shared, it must be freed by MPI_Win_free
-        for (int i = nChunks; i < this->nodeCoeffChunks.size(); i++) delete[] this->nodeCoeffChunks[i];
+    for (int i = nChunks; i < this->nodeChunks.size(); i++) this->freeChunk(i); // remove unused chunks
 
     // shrink the stacks
     this->nodeChunks.resize(nChunks);
     this->nodeCoeffChunks.resize(nChunks);
+    this->nodeCoeffChunkHuge.resize(nChunks);
     this->nodeStackStatus.resize(nChunks * this->maxNodesPerChunk);
 
     this->maxNodes = this->nodeStackStatus.size();
 
     this->getTree()->resetEndNodeTable();
+    if (this->getTree()->hasNodeHashTable()) this->getTree()->makeNodeHashTable(); // nodes have moved
 
     return nChunksStart - nChunks;
 }
 
-// return pointer to the last active node or NULL if failed
+/** Allocate a group of consecutive GenNodes from the arena of the calling thread.
+ * Only the claiming of a fresh chunk is serialized, the allocation itself is
+ * lock-free. Returns a pointer to the first node of the group. */
 template <int D> GenNode<D> *SerialFunctionTree<D>::allocGenNodes(int nAlloc, int *serialIx, double **coefs_p) {
-    omp_set_lock(&Sfunc_tree_lock);
-    *serialIx = this->nGenNodes;
-    int chunkIx = *serialIx % (this->maxNodesPerChunk);
-
     // Not necessarily wrong, but new:
     assert(nAlloc == (1 << D));
 
-    if (chunkIx == 0 or chunkIx + nAlloc > this->maxNodesPerChunk) {
-        // start on new chunk
-        // we want nodes allocated simultaneously to be allocated on the same chunk.
-        // possibly jump over the last nodes from the old chunk
-        this->nGenNodes =
-            this->maxNodesPerChunk * ((this->nGenNodes + nAlloc - 1) / this->maxNodesPerChunk); // start of next chunk
+    // Reserve the nodes before touching the arena, so that deallocGenNodes
+    // never releases the chunks while an allocation is under way
+    while (this->nGenNodes.fetch_add(nAlloc) < 0) {
+        // the chunks are being released, wait until it is done
+        this->nGenNodes -= nAlloc;
+        omp_set_lock(&Sfunc_tree_lock);
+        omp_unset_lock(&Sfunc_tree_lock);
+    }
 
-        int chunk = this->nGenNodes / this->maxNodesPerChunk; // find the right chunk
+    int n = omp_get_thread_num();
+    assert(n < this->genNodeArenas.size());
+    GenNodeArena &arena = this->genNodeArenas[n];
 
-        // careful: nodeChunks.size() is an unsigned int
-        if (chunk + 1 > this->genNodeChunks.size()) {
-            // need to allocate new chunk
-            this->sGenNodes = (GenNode<D> *)new char[this->maxNodesPerChunk * sizeof(GenNode<D>)];
-            for (int i = 0; i < this->maxNodesPerChunk; i++) {
-                this->sGenNodes[i].serialIx = -1;
-                this->sGenNodes[i].parentSerialIx = -1;
-                this->sGenNodes[i].childSerialIx = -1;
-            }
-            this->genNodeChunks.push_back(this->sGenNodes);
-            auto *sGenNodesCoeff = new double[this->sizeGenNodeCoeff * this->maxNodesPerChunk];
-            this->genNodeCoeffChunks.push_back(sGenNodesCoeff);
-            // allocate new chunk in nodeStackStatus
-            int oldsize = this->genNodeStackStatus.size();
-            int newsize = oldsize + this->maxNodesPerChunk;
-            for (int i = oldsize; i < newsize; i++) this->genNodeStackStatus.push_back(0);
-            this->maxGenNodes = newsize;
+    // first try to recycle a group that has been returned to this arena
+    if (arena.freeGroups == nullptr) arena.freeGroups = arena.returnedGroups.exchange(nullptr, std::memory_order_acquire);
 
-            if (chunk % 100 == 99 and D == 3)
-                println(10,
-                        "\n number of GenNodes " << this->nGenNodes << ",number of GenNodechunks now "
-                                                 << this->genNodeChunks.size() << ", total size coeff  (MB) "
-                                                 << (this->nGenNodes / 1024) * this->sizeGenNodeCoeff / 128);
+    GenNode<D> *newNode = nullptr;
+    if (arena.freeGroups != nullptr) {
+        // recycled groups are already marked as occupied
+        newNode = arena.freeGroups;
+        arena.freeGroups = static_cast<GenNode<D> *>(newNode->children[0]);
+        *serialIx = newNode->serialIx;
+        *coefs_p = newNode->coefs;
+    } else {
+        if (arena.nodes == nullptr or arena.nextIx + nAlloc > this->maxNodesPerChunk) this->claimGenNodeChunk(arena);
+        newNode = arena.nodes + arena.nextIx;
+        *serialIx = arena.firstIx + arena.nextIx;
+        *coefs_p = arena.coefs + arena.nextIx * this->sizeGenNodeCoeff;
+        for (int i = 0; i < nAlloc; i++) {
+            int &status = arena.status[arena.nextIx + i];
+            if (status != 0) println(0, *serialIx + i << " NodeStackStatus: not available " << status);
+            status = 1;
         }
-        this->lastGenNode = this->genNodeChunks[chunk] + this->nGenNodes % (this->maxNodesPerChunk);
-        *serialIx = this->nGenNodes;
-        chunkIx = *serialIx % (this->maxNodesPerChunk);
+        arena.nextIx += nAlloc;
     }
-    assert((this->nGenNodes + nAlloc - 1) / this->maxNodesPerChunk < this->genNodeChunks.size());
+    for (int i = 0; i < nAlloc; i++) (newNode + i)->serialIx = *serialIx + i; // Until overwritten!
 
-    GenNode<D> *newNode = this->lastGenNode;
-    GenNode<D> *newNode_cp = newNode;
+    return newNode;
+}
 
-    int chunk = this->nGenNodes / this->maxNodesPerChunk; // find the right chunk
-    *coefs_p = this->genNodeCoeffChunks[chunk] + chunkIx * this->sizeGenNodeCoeff;
+/** Rewrite all ProjectedNodes and their coefficients into fresh chunks.
+ *
+ * Nodes are laid out in the order of a HilbertIterator traversal: the roots
+ * first, then the sibling groups in the order their parents are visited.
+ * Holes left by deallocated nodes are squeezed out and the old chunks are
+ * released. GenNodes must be removed beforehand. Returns the number of
+ * chunks released. */
+template <int D> int SerialFunctionTree<D>::repack() {
+    if (this->isShared()) MSG_ABORT("Cannot repack a tree in shared memory");
+    if (this->singlePrecision) MSG_ABORT("Cannot repack a tree stored in single precision");
+    if (this->nGenNodes > 0) MSG_ABORT("GenNodes must be deleted before repacking");
+
+    const int tDim = (1 << D);
+    MWTree<D> &tree = *this->getTree();
+    NodeBox<D> &rBox = tree.getRootBox();
+
+    // new position of each node, sibling groups are kept within one chunk
+    std::vector<int> newIx(this->nNodes, -1);
+    int nNew = 0;
+    auto place = [this, &newIx, &nNew](int sIdx, int n) {
+        if (nNew % this->maxNodesPerChunk + n > this->maxNodesPerChunk)
+            nNew = this->maxNodesPerChunk * (nNew / this->maxNodesPerChunk + 1);
+        for (int i = 0; i < n; i++) newIx[sIdx + i] = nNew++;
+    };
+
+    std::vector<MWNode<D> *> stack;
+    for (int i = 0; i < rBox.size(); i++) place(rBox.getNode(i).serialIx, 1);
+    for (int i = rBox.size() - 1; i >= 0; i--) stack.push_back(&rBox.getNode(i));
+    while (not stack.empty()) {
+        MWNode<D> *node = stack.back();
+        stack.pop_back();
+        if (not node->isBranchNode()) continue;
+        place(node->childSerialIx, tDim);
+        const HilbertPath<D> &h = node->getHilbertPath();
+        for (int i = tDim - 1; i >= 0; i--) stack.push_back(node->children[h.getZIndex(i)]);
+    }
+    const int nChunksStart = this->nodeChunks.size();
+    const int nChunks = std::max(1, (nNew + this->maxNodesPerChunk - 1) / this->maxNodesPerChunk);
+
+    // topology in the new positions
+    this->packTopology(nChunksStart);
+    std::vector<unsigned char> status(nChunks * this->maxNodesPerChunk, 0);
+    std::vector<short int> scale(status.size(), 0);
+    std::vector<int> translation(D * status.size(), 0);
+    std::vector<int> parentIx(status.size(), -1);
+    std::vector<int> childIx(status.size(), -1);
+    std::vector<double> norms((tDim + 1) * status.size(), 0.0);
+    for (int sIdx = 0; sIdx < this->nNodes; sIdx++) {
+        int n = newIx[sIdx];
+        if (n < 0) continue;
+        int parent = this->topoParentIx[sIdx];
+        int child = this->topoChildIx[sIdx];
+        status[n] = this->topoStatus[sIdx];
+        scale[n] = this->topoScale[sIdx];
+        parentIx[n] = (parent < 0) ? -1 : newIx[parent];
+        childIx[n] = (child < 0) ? -1 : newIx[child];
+        for (int d = 0; d < D; d++) translation[D * n + d] = this->topoTranslation[D * sIdx + d];
+        for (int i = 0; i <= tDim; i++) norms[(tDim + 1) * n + i] = this->topoNorms[(tDim + 1) * sIdx + i];
+    }
+    this->topoStatus.swap(status);
+    this->topoScale.swap(scale);
+    this->topoTranslation.swap(translation);
+    this->topoParentIx.swap(parentIx);
+    this->topoChildIx.swap(childIx);
+    this->topoNorms.swap(norms);
+
+    // move the old chunks aside and copy the coefficients into fresh ones
+    std::vector<ProjectedNode<D> *> oldNodeChunks;
+    std::vector<double *> oldCoeffChunks;
+    std::vector<bool> oldCoeffChunkHuge;
+    oldNodeChunks.swap(this->nodeChunks);
+    oldCoeffChunks.swap(this->nodeCoeffChunks);
+    oldCoeffChunkHuge.swap(this->nodeCoeffChunkHuge);
+    this->nodeStackStatus.clear();
+    for (int i = 0; i < nChunks; i++) this->appendChunk();
+
+    const int nOld = this->nNodes;
+#pragma omp parallel for schedule(static)
+    for (int sIdx = 0; sIdx < nOld; sIdx++) {
+        int n = newIx[sIdx];
+        if (n < 0) continue;
+        const double *src = oldCoeffChunks[sIdx / this->maxNodesPerChunk] + (sIdx % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+        double *dst = this->nodeCoeffChunks[n / this->maxNodesPerChunk] + (n % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+        std::copy(src, src + this->sizeNodeCoeff, dst);
+    }
 
-    for (int i = 0; i < nAlloc; i++) {
-        newNode_cp->serialIx = *serialIx + i; // Until overwritten!
-        if (this->genNodeStackStatus[*serialIx + i] != 0)
-            println(0, *serialIx + i << " NodeStackStatus: not available " << this->genNodeStackStatus[*serialIx + i]);
-        this->genNodeStackStatus[*serialIx + i] = 1;
-        newNode_cp++;
+    for (int i = 0; i < oldNodeChunks.size(); i++) this->releaseChunk(oldNodeChunks[i], oldCoeffChunks[i], oldCoeffChunkHuge[i]);
+
+    // the nodes are only moved, the norm of the tree is unchanged
+    double sqNorm = tree.getSquareNorm();
+    this->unpackTopology();
+    this->clearTopology();
+    tree.squareNorm = sqNorm;
+
+    return nChunksStart - nChunks;
+}
+
+/** Convert the coefficients to single precision storage.
+ *
+ * The coefficients of each chunk are rounded into nodeCoeffChunksSP and the
+ * double precision chunks are released, halving the coefficient memory. The
+ * norms of the nodes are kept in double precision. Node coefs pointers are
+ * set to null and FlagHasCoefs is cleared (and remembered in nodeHasCoefsSP),
+ * so that the coefficient access paths abort instead of reading through a
+ * null pointer: the tree can be saved or sent, and read through widenCoefs,
+ * but must otherwise be converted back with toDoublePrecision() before it is
+ * used in a computation. GenNodes must be removed beforehand. */
+template <int D> void SerialFunctionTree<D>::toSinglePrecision() {
+    if (this->singlePrecision) return;
+    if (this->isShared()) MSG_ABORT("Cannot store a tree in shared memory in single precision");
+    if (this->nGenNodes > 0) MSG_ABORT("GenNodes must be deleted before conversion");
+
+    const int nDoubles = this->sizeNodeCoeff * this->maxNodesPerChunk;
+    const int nChunks = this->nodeChunks.size();
+    this->nodeCoeffChunksSP.resize(nChunks);
+    for (int i = 0; i < nChunks; i++) this->nodeCoeffChunksSP[i] = new float[nDoubles];
+
+    const int nSlots = this->nNodes;
+    this->nodeHasCoefsSP.assign(nSlots, 0);
+#pragma omp parallel for schedule(static)
+    for (int sIdx = 0; sIdx < nSlots; sIdx++) {
+        if (this->nodeStackStatus[sIdx] == 0) continue;
+        ProjectedNode<D> &node = *(this->nodeChunks[sIdx / this->maxNodesPerChunk] + sIdx % this->maxNodesPerChunk);
+        float *sp = this->nodeCoeffChunksSP[sIdx / this->maxNodesPerChunk] + (sIdx % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+        if (node.hasCoefs()) {
+            for (int j = 0; j < this->sizeNodeCoeff; j++) sp[j] = static_cast<float>(node.coefs[j]);
+            this->nodeHasCoefsSP[sIdx] = 1;
+            node.clearHasCoefs();
+        }
+        node.coefs = nullptr;
+    }
+
+    for (int i = 0; i < nChunks; i++) {
+        numa_utils::free_chunk(this->nodeCoeffChunks[i], nDoubles, this->nodeCoeffChunkHuge[i]);
+        this->nodeCoeffChunks[i] = nullptr;
+    }
+    this->singlePrecision = true;
+}
+
+/** Convert the coefficients back to double precision storage. The new
+ * chunks are first touched by the threads converting the nodes. */
+template <int D> void SerialFunctionTree<D>::toDoublePrecision() {
+    if (not this->singlePrecision) return;
+
+    const int nDoubles = this->sizeNodeCoeff * this->maxNodesPerChunk;
+    const int nChunks = this->nodeChunks.size();
+    for (int i = 0; i < nChunks; i++) {
+        this->nodeCoeffChunks[i] = numa_utils::alloc_chunk(nDoubles, this->hugePages);
+        this->nodeCoeffChunkHuge[i] = this->hugePages;
+    }
+
+    const int nSlots = this->nNodes;
+#pragma omp parallel for schedule(static)
+    for (int sIdx = 0; sIdx < nSlots; sIdx++) {
+        if (this->nodeStackStatus[sIdx] == 0) continue;
+        ProjectedNode<D> &node = *(this->nodeChunks[sIdx / this->maxNodesPerChunk] + sIdx % this->maxNodesPerChunk);
+        const float *sp = this->nodeCoeffChunksSP[sIdx / this->maxNodesPerChunk] + (sIdx % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+        node.coefs = this->nodeCoeffChunks[sIdx / this->maxNodesPerChunk] + (sIdx % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+        if (this->nodeHasCoefsSP[sIdx]) {
+            for (int j = 0; j < this->sizeNodeCoeff; j++) node.coefs[j] = static_cast<double>(sp[j]);
+            node.setHasCoefs();
+        }
+    }
+
+    for (auto &chunk : this->nodeCoeffChunksSP) delete[] chunk;
+    this->nodeCoeffChunksSP.clear();
+    this->nodeHasCoefsSP.clear();
+    this->singlePrecision = false;
+}
+
+/** Copy the single precision coefs of a node into the double vector c, which
+ * must hold sizeNodeCoeff values. Returns false if the node had no coefs.
+ * Nothing is modified, so this can be called concurrently from several
+ * threads. */
+template <int D> bool SerialFunctionTree<D>::widenCoefs(const MWNode<D> &node, double *c) const {
+    int sIdx = node.getSerialIx();
+    if (not this->nodeHasCoefsSP[sIdx]) return false;
+    const float *sp = this->nodeCoeffChunksSP[sIdx / this->maxNodesPerChunk] + (sIdx % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+    for (int j = 0; j < this->sizeNodeCoeff; j++) c[j] = static_cast<double>(sp[j]);
+    return true;
+}
+
+/** Back coefficient chunks allocated from now on with 2 MB huge pages.
+ * Placement is then decided per chunk rather than per 4 kB page, so this
+ * only pays off for D = 3, where a chunk is close to 2 MB. Existing chunks
+ * are not affected, and shared memory trees are never affected. */
+template <int D> void SerialFunctionTree<D>::setHugePages(bool enable) {
+    this->hugePages = enable;
+}
+
+/** Release one ProjectedNode chunk with its coefficients. Shared coefficients
+ * are left alone, they must be freed by MPI_Win_free */
+template <int D> void SerialFunctionTree<D>::freeChunk(int iChunk) {
+    double *coefs = (this->isShared()) ? nullptr : this->nodeCoeffChunks[iChunk];
+    this->releaseChunk(this->nodeChunks[iChunk], coefs, this->nodeCoeffChunkHuge[iChunk]);
+}
+
+/** Give a chunk back to the ChunkPool, or free it if the pool does not take it */
+template <int D> void SerialFunctionTree<D>::releaseChunk(ProjectedNode<D> *nodes, double *coefs, bool huge) {
+    const int nDoubles = this->sizeNodeCoeff * this->maxNodesPerChunk;
+    if (coefs != nullptr and not huge and ChunkPool::push(D, this->sizeGenNodeCoeff, (char *)nodes, coefs, nDoubles)) return;
+    delete[](char *) nodes;
+    if (coefs != nullptr) numa_utils::free_chunk(coefs, nDoubles, huge);
+}
+
+/** Number of coefficient pages in each NUMA domain, domain -1 holds pages not
+ * yet touched. Returns an empty map if the placement cannot be queried. */
+template <int D> std::map<int, int> SerialFunctionTree<D>::getNumaPageCount() const {
+    std::map<int, int> pages;
+    int nDoubles = this->sizeNodeCoeff * this->maxNodesPerChunk;
+    for (auto *chunk : this->nodeCoeffChunks) numa_utils::count_pages(chunk, nDoubles, pages);
+    return pages;
+}
+
+/** Print the spread of the coefficient pages over the NUMA domains */
+template <int D> void SerialFunctionTree<D>::printNumaReport() const {
+    std::map<int, int> pages = getNumaPageCount();
+    int nPages = 0;
+    for (auto &p : pages) nPages += p.second;
+
+    println(0, " NUMA placement of " << this->nodeCoeffChunks.size() << " coefficient chunks");
+    if (nPages == 0) println(0, "   not available");
+    for (auto &p : pages) {
+        if (p.first < 0) {
+            printout(0, "   untouched  ");
+        } else {
+            printout(0, "   domain " << std::setw(3) << p.first);
+        }
+        println(0, std::setw(10) << p.second << " pages " << std::setw(6) << std::fixed << std::setprecision(1)
+                                 << (100.0 * p.second) / nPages << " %");
+    }
+}
+
+/** Give a new GenNode chunk to the arena. The unused tail of the previous chunk
+ * is left empty, chunks are only deleted all together once no GenNodes remain. */
+template <int D> void SerialFunctionTree<D>::claimGenNodeChunk(GenNodeArena &arena) {
+    auto *sGenNodes = (GenNode<D> *)new char[this->maxNodesPerChunk * sizeof(GenNode<D>)];
+    for (int i = 0; i < this->maxNodesPerChunk; i++) {
+        sGenNodes[i].serialIx = -1;
+        sGenNodes[i].parentSerialIx = -1;
+        sGenNodes[i].childSerialIx = -1;
     }
-    this->nGenNodes += nAlloc;
-    this->lastGenNode += nAlloc;
+    auto *sGenNodesCoeff = numa_utils::alloc_chunk(this->sizeGenNodeCoeff * this->maxNodesPerChunk);
+    auto *sGenNodesStatus = new int[this->maxNodesPerChunk];
+    for (int i = 0; i < this->maxNodesPerChunk; i++) sGenNodesStatus[i] = 0;
 
+    omp_set_lock(&Sfunc_tree_lock);
+    int chunk = this->genNodeChunks.size();
+    this->sGenNodes = sGenNodes;
+    this->genNodeChunks.push_back(sGenNodes);
+    this->genNodeCoeffChunks.push_back(sGenNodesCoeff);
+    this->genNodeStatusChunks.push_back(sGenNodesStatus);
+    this->genNodeChunkOwner.push_back(&arena - this->genNodeArenas.data());
+    this->maxGenNodes = this->genNodeChunks.size() * this->maxNodesPerChunk;
+
+    if (chunk % 100 == 99 and D == 3)
+        println(10,
+                "\n number of GenNodes " << this->nGenNodes << ",number of GenNodechunks now "
+                                         << this->genNodeChunks.size() << ", total size coeff  (MB) "
+                                         << (this->maxGenNodes / 1024) * this->sizeGenNodeCoeff / 128);
     omp_unset_lock(&Sfunc_tree_lock);
-    return newNode;
+
+    arena.nodes = sGenNodes;
+    arena.coefs = sGenNodesCoeff;
+    arena.status = sGenNodesStatus;
+    arena.firstIx = chunk * this->maxNodesPerChunk;
+    arena.nextIx = 0;
 }
 
+/** Mark the GenNode as available. Once all siblings of a group are released the
+ * group is returned to the arena owning its chunk. When no GenNodes are left all
+ * GenNode chunks are deleted. */
 template <int D> void SerialFunctionTree<D>::deallocGenNodes(int serialIx) {
     omp_set_lock(&Sfunc_tree_lock);
-    if (this->nGenNodes < 0) {
-        println(0, "minNodes exceeded " << this->nGenNodes);
-        this->nGenNodes++;
-    }
-    this->genNodeStackStatus[serialIx] = 0; // mark as available
-    if (serialIx == this->nGenNodes - 1) {  // top of stack
-        int topStack = this->nGenNodes;
-        while (this->genNodeStackStatus[topStack - 1] == 0) {
-            topStack--;
-            if (topStack < 1) {
-                // remove all the GenNodeChunks once there are noe more genNodes
-                this->deallocGenNodeChunks();
-                break;
-            }
+    int nAlloc = (1 << D);
+    int chunk = serialIx / this->maxNodesPerChunk;
+    int inode = serialIx % this->maxNodesPerChunk;
+    int *status = this->genNodeStatusChunks[chunk];
+    status[inode] = 0; // mark as available
+
+    int first = inode - inode % nAlloc; // groups are aligned within a chunk
+    bool groupReleased = true;
+    for (int i = first; i < first + nAlloc; i++) groupReleased = groupReleased and (status[i] == 0);
+
+    int nLeft = --this->nGenNodes;
+    if (nLeft < 0) println(0, "minNodes exceeded " << nLeft);
+    if (nLeft <= 0) {
+        // remove all the GenNodeChunks once there are no more genNodes. The
+        // count is parked at a large negative value during the release, so
+        // that concurrent allocations wait for it instead of using the chunks
+        int expected = nLeft;
+        const int release = 1 << 30;
+        if (this->nGenNodes.compare_exchange_strong(expected, -release)) {
+            this->freeGenNodeChunks();
+            this->nGenNodes += release;
         }
-        this->nGenNodes = topStack; // move top of stack
-        // has to redefine lastGenNode
-        int chunk = this->nGenNodes / this->maxNodesPerChunk; // find the right chunk
-        this->lastGenNode = this->genNodeChunks[chunk] + this->nGenNodes % (this->maxNodesPerChunk);
+    } else if (groupReleased) {
+        // the group stays marked as occupied while it sits in the free list
+        for (int i = first; i < first + nAlloc; i++) status[i] = 1;
+        GenNode<D> *head = this->genNodeChunks[chunk] + first;
+        head->serialIx = chunk * this->maxNodesPerChunk + first;
+        head->coefs = this->genNodeCoeffChunks[chunk] + first * this->sizeGenNodeCoeff;
+        std::atomic<GenNode<D> *> &returned = this->genNodeArenas[this->genNodeChunkOwner[chunk]].returnedGroups;
+        GenNode<D> *next = returned.load(std::memory_order_relaxed);
+        do {
+            head->children[0] = next;
+        } while (not returned.compare_exchange_weak(next, head, std::memory_order_release, std::memory_order_relaxed));
     }
     omp_unset_lock(&Sfunc_tree_lock);
 }
 
 template <int D> void SerialFunctionTree<D>::deallocGenNodeChunks() {
-    // if(mpiOrbRank==0 and (this->genNodeCoeffChunks.size()*2)*1024/8>10000)cout<<"deallocate genchunks MB
-    // "<<(this->genNodeCoeffChunks.size()*2)*1024/1024/8<<endl;
-    for (int i = 0; i < this->genNodeCoeffChunks.size(); i++) delete[] this->genNodeCoeffChunks[i];
-    for (int i = 0; i < this->genNodeChunks.size(); i++) delete[](char *)(this->genNodeChunks[i]);
-    this->genNodeCoeffChunks.clear();
-    this->genNodeChunks.clear();
-    this->genNodeStackStatus.clear();
+    this->freeGenNodeChunks();
+    this->nGenNodes = 0;
 }
 
-/** Traverse tree and redefine pointer, counter and tables. */
-template <int D> void SerialFunctionTree<D>::rewritePointers() {
-
-    this->getTree()->nNodes = 0;
-    this->getTree()->nodesAtDepth.clear();
-    this->getTree()->squareNorm = 0.0;
-    this->getTree()->clearEndNodeTable();
-
-    // reinitialize stacks
-    for (int i = 0; i < this->nodeStackStatus.size(); i++) this->nodeStackStatus[i] = 0;
-    // nodeChunks have been adapted to receiving tree and maybe larger than nodeStackStatus
-    int nodecount = this->nodeChunks.size() * this->maxNodesPerChunk;
-    while (nodecount > this->nodeStackStatus.size()) this->nodeStackStatus.push_back(0);
-    this->maxNodes = this->nodeStackStatus.size();
-
-    // clear all gennodes and their chunks:
-    for (int i = 0; i < this->genNodeCoeffChunks.size(); i++) delete[] this->genNodeCoeffChunks[i];
+/** Release all GenNode chunks and reset the arenas, without touching the
+ * GenNode count */
+template <int D> void SerialFunctionTree<D>::freeGenNodeChunks() {
+    for (int i = 0; i < this->genNodeCoeffChunks.size(); i++)
+        numa_utils::free_chunk(this->genNodeCoeffChunks[i], this->sizeGenNodeCoeff * this->maxNodesPerChunk);
     for (int i = 0; i < this->genNodeChunks.size(); i++) delete[](char *)(this->genNodeChunks[i]);
+    for (int i = 0; i < this->genNodeStatusChunks.size(); i++) delete[] this->genNodeStatusChunks[i];
     this->genNodeCoeffChunks.clear();
-    this->genNodeStackStatus.clear();
     this->genNodeChunks.clear();
-    this->nGenNodes = 0;
+    this->genNodeStatusChunks.clear();
+    this->genNodeChunkOwner.clear();
+    this->sGenNodes = nullptr;
     this->maxGenNodes = 0;
+    this->resetGenNodeArenas();
+}
+
+template <int D> void SerialFunctionTree<D>::resetGenNodeArenas() {
+    for (auto &arena : this->genNodeArenas) {
+        arena.nodes = nullptr;
+        arena.coefs = nullptr;
+        arena.status = nullptr;
+        arena.firstIx = 0;
+        arena.nextIx = 0;
+        arena.freeGroups = nullptr;
+        arena.returnedGroups.store(nullptr, std::memory_order_relaxed);
+    }
+}
 
-    NodeBox<D> &rBox = this->getTree()->getRootBox();
-    MWNode<D> **roots = rBox.getNodes();
+/** Store the topology of the ProjectedNodes in the packed topo* arrays.
+ *
+ * The arrays are indexed by serialIx and cover nChunks full chunks (default
+ * all chunks in use), unused positions get a zero status. Together with the
+ * coefficient chunks this is a complete, pointer free, description of the
+ * tree. GenNodes are not included. */
+template <int D> void SerialFunctionTree<D>::packTopology(int nChunks) {
+    packTopology(*this, nChunks);
+}
 
-    int DepthMax = 100, slen = 0;
-    ProjectedNode<D> *stack[DepthMax * 8];
-    for (int rIdx = 0; rIdx < rBox.size(); rIdx++) {
-        roots[rIdx] = (this->nodeChunks[0]) + rIdx; // adress of roots are at start of NodeChunks[0] array
-        stack[slen++] = (this->nodeChunks[0]) + rIdx;
+/** Store the topology of the ProjectedNodes in the packed topo* arrays of
+ * dst, which may be another tree. This tree is not modified. */
+template <int D> void SerialFunctionTree<D>::packTopology(SerialFunctionTree<D> &dst, int nChunks) const {
+    const int tDim = (1 << D);
+    if (nChunks < 0) nChunks = this->getNChunksUsed();
+    const int nSlots = nChunks * this->maxNodesPerChunk;
+
+    dst.topoStatus.assign(nSlots, 0);
+    dst.topoScale.assign(nSlots, 0);
+    dst.topoTranslation.assign(D * nSlots, 0);
+    dst.topoParentIx.assign(nSlots, -1);
+    dst.topoChildIx.assign(nSlots, -1);
+    dst.topoNorms.assign((tDim + 1) * nSlots, 0.0);
+
+    for (int sIdx = 0; sIdx < std::min(nSlots, this->nNodes); sIdx++) {
+        if (this->nodeStackStatus[sIdx] == 0) continue;
+        const ProjectedNode<D> &node = *(this->nodeChunks[sIdx / this->maxNodesPerChunk] + sIdx % this->maxNodesPerChunk);
+        const NodeIndex<D> &idx = node.getNodeIndex();
+        // GenNode children are not packed, their parent is stored as a leaf
+        bool hasChildren = node.isBranchNode() and not node.isEndNode();
+        dst.topoStatus[sIdx] = node.status & ~MWNode<D>::FlagGenerating;
+        if (this->singlePrecision and this->nodeHasCoefsSP[sIdx]) dst.topoStatus[sIdx] |= MWNode<D>::FlagHasCoefs;
+        if (not hasChildren) dst.topoStatus[sIdx] &= ~MWNode<D>::FlagBranchNode;
+        dst.topoScale[sIdx] = idx.getScale();
+        for (int d = 0; d < D; d++) dst.topoTranslation[D * sIdx + d] = idx.getTranslation(d);
+        dst.topoParentIx[sIdx] = node.parentSerialIx;
+        dst.topoChildIx[sIdx] = (hasChildren) ? node.childSerialIx : -1;
+        dst.topoNorms[(tDim + 1) * sIdx] = node.squareNorm;
+        for (int i = 0; i < tDim; i++) dst.topoNorms[(tDim + 1) * sIdx + 1 + i] = node.componentNorms[i];
     }
-    this->nNodes = 0;
-    while (slen) {
-        ProjectedNode<D> *node = stack[--slen];
-        for (int i = 0; i < node->getNChildren(); i++) {
-            int n_ichunk = (node->childSerialIx + i) / this->maxNodesPerChunk;
-            int n_inode = (node->childSerialIx + i) % this->maxNodesPerChunk;
-            stack[slen++] = this->nodeChunks[n_ichunk] + n_inode;
-        }
-        int ichunk = node->serialIx / this->maxNodesPerChunk;
-        int inode = node->serialIx % this->maxNodesPerChunk;
+}
+
+/** Construct the ProjectedNodes from the packed topo* arrays.
+ *
+ * Coefficients are assumed to be in place in nodeCoeffChunks, and the arrays
+ * to cover a whole number of chunks. Nodes are
+ * constructed in their serialIx position, and all pointers, counters and
+ * tables of the tree are redefined. The tree norm is the sum of the EndNode
+ * norms, or -1 if any EndNode has no coefs. Any existing GenNodes are removed. */
+template <int D> void SerialFunctionTree<D>::unpackTopology() {
+    const int tDim = (1 << D);
+    const int nSlots = this->topoStatus.size();
+    MWTree<D> &tree = *this->getTree();
 
-        this->nNodes = std::max(this->nNodes, ichunk * this->maxNodesPerChunk + inode + 1);
-        this->getTree()->incrementNodeCount(node->getScale());
-        if (node->isEndNode()) this->getTree()->squareNorm += node->getSquareNorm();
-        if (node->isEndNode()) this->getTree()->endNodeTable.push_back(node);
+    // clear all gennodes and their chunks:
+    this->deallocGenNodeChunks();
 
-        // normally (intel) the virtual table does not change, but we overwrite anyway
-        *(char **)(node) = this->cvptr_ProjectedNode;
+    while (this->nodeChunks.size() * this->maxNodesPerChunk < nSlots) this->appendChunk();
+    for (int i = 0; i < this->nodeStackStatus.size(); i++) this->nodeStackStatus[i] = 0;
 
-        node->tree = this->getTree();
+    tree.nNodes = 0;
+    tree.nodesAtDepth.clear();
+    tree.squareNorm = 0.0;
+    bool validNorm = true; // all EndNodes have coefs, see MWTree::calcSquareNorm
 
-        //"adress" of coefs is the same as node, but in another array
-        node->coefs = this->nodeCoeffChunks[ichunk] + inode * this->sizeNodeCoeff;
+    auto nodeAt = [this](int sIdx) { return this->nodeChunks[sIdx / this->maxNodesPerChunk] + sIdx % this->maxNodesPerChunk; };
 
-        // adress of parent and children must be corrected
-        // can be on a different chunks
-        if (node->parentSerialIx >= 0) {
-            int n_ichunk = node->parentSerialIx / this->maxNodesPerChunk;
-            int n_inode = node->parentSerialIx % this->maxNodesPerChunk;
-            node->parent = this->nodeChunks[n_ichunk] + n_inode;
-            assert(node->parent->serialIx == node->parentSerialIx);
-        } else {
+    this->nNodes = 0;
+    for (int sIdx = 0; sIdx < nSlots; sIdx++) {
+        if (this->topoStatus[sIdx] == 0) continue;
+        ProjectedNode<D> *node = nodeAt(sIdx);
+        new (node) ProjectedNode<D>();
+
+        node->tree = &tree;
+        node->nodeIndex = NodeIndex<D>(this->topoScale[sIdx], &this->topoTranslation[D * sIdx]);
+        node->n_coefs = this->sizeNodeCoeff;
+        node->coefs = this->nodeCoeffChunks[sIdx / this->maxNodesPerChunk] + (sIdx % this->maxNodesPerChunk) * this->sizeNodeCoeff;
+
+        node->serialIx = sIdx;
+        node->parentSerialIx = this->topoParentIx[sIdx];
+        node->childSerialIx = this->topoChildIx[sIdx];
+        node->status = this->topoStatus[sIdx];
+
+        node->squareNorm = this->topoNorms[(tDim + 1) * sIdx];
+        for (int i = 0; i < tDim; i++) node->componentNorms[i] = this->topoNorms[(tDim + 1) * sIdx + 1 + i];
+
+        this->nodeStackStatus[sIdx] = 1; // occupied
+        this->nNodes = sIdx + 1;
+        tree.incrementNodeCount(node->getScale());
+        if (node->isEndNode()) {
+            if (not node->hasCoefs() or node->getSquareNorm() < 0.0) validNorm = false;
+            tree.squareNorm += node->getSquareNorm();
+        }
+    }
+    if (not validNorm) tree.squareNorm = -1.0;
+
+    // link parents and children, and register the roots
+    NodeBox<D> &rBox = tree.getRootBox();
+    std::vector<ProjectedNode<D> *> stack;
+    for (int sIdx = 0; sIdx < this->nNodes; sIdx++) {
+        if (this->nodeStackStatus[sIdx] == 0) continue;
+        ProjectedNode<D> *node = nodeAt(sIdx);
+        if (node->parentSerialIx < 0) {
             node->parent = nullptr;
+            rBox.getNodes()[rBox.getBoxIndex(node->getNodeIndex())] = node;
+            stack.push_back(node);
+        } else {
+            node->parent = nodeAt(node->parentSerialIx);
+        }
+        for (int i = 0; i < tDim; i++) {
+            node->children[i] = (node->childSerialIx >= 0) ? nodeAt(node->childSerialIx + i) : nullptr;
         }
+    }
 
+    // Hilbert paths are defined top-down (children may be stored before their parent)
+    while (not stack.empty()) {
+        ProjectedNode<D> *node = stack.back();
+        stack.pop_back();
         for (int i = 0; i < node->getNChildren(); i++) {
-            int n_ichunk = (node->childSerialIx + i) / this->maxNodesPerChunk;
-            int n_inode = (node->childSerialIx + i) % this->maxNodesPerChunk;
-            node->children[i] = this->nodeChunks[n_ichunk] + n_inode;
+            auto *child = static_cast<ProjectedNode<D> *>(node->children[i]);
+            child->hilbertPath = HilbertPath<D>(node->getHilbertPath(), i);
+            stack.push_back(child);
         }
-        this->nodeStackStatus[node->serialIx] = 1; // occupied
     }
+
     int ichunk = this->nNodes / this->maxNodesPerChunk;
     int inode = this->nNodes % this->maxNodesPerChunk;
-    this->lastNode = this->nodeChunks[ichunk] + inode;
+    this->lastNode = (ichunk < this->nodeChunks.size()) ? this->nodeChunks[ichunk] + inode : nullptr;
+
+    tree.resetEndNodeTable();
+    if (tree.hasNodeHashTable()) tree.makeNodeHashTable();
+}
+
+/** Replace the nodes of this tree with an empty copy of the grid of src.
+ *
+ * The topology of src is packed into the arrays of this tree and unpacked in
+ * place, reusing the existing chunks. The source tree is not modified, so
+ * several trees can copy the same grid concurrently. No coefficients are
+ * copied: all nodes are left without coefficients and with undefined norms,
+ * as after a grid copy with TreeBuilder. GenNodes of src are not copied. */
+template <int D> void SerialFunctionTree<D>::copyTopology(const SerialFunctionTree<D> &src) {
+    src.packTopology(*this);
+    for (auto &status : this->topoStatus) status &= ~MWNode<D>::FlagHasCoefs;
+    for (auto &norm : this->topoNorms) norm = -1.0;
+
+    this->unpackTopology();
+    this->clearTopology();
+    this->getTree()->clearSquareNorm();
+}
+
+/** Copy the coefficients and norms of all nodes of src, if the two trees
+ * have identical node layouts, e.g. after copyTopology. Returns false and
+ * leaves the tree unchanged if the layouts differ. */
+template <int D> bool SerialFunctionTree<D>::copyCoefs(SerialFunctionTree<D> &src) {
+    if (this->sizeNodeCoeff != src.sizeNodeCoeff) return false;
+    if (this->singlePrecision or src.singlePrecision) return false;
+
+    auto nodeAt = [](SerialFunctionTree<D> &t, int sIdx) {
+        return t.nodeChunks[sIdx / t.maxNodesPerChunk] + sIdx % t.maxNodesPerChunk;
+    };
+    auto isOccupied = [](SerialFunctionTree<D> &t, int sIdx) {
+        return sIdx < t.nNodes and t.nodeStackStatus[sIdx] != 0;
+    };
+    for (int sIdx = 0; sIdx < std::max(this->nNodes, src.nNodes); sIdx++) {
+        if (isOccupied(*this, sIdx) != isOccupied(src, sIdx)) return false;
+        if (not isOccupied(*this, sIdx)) continue;
+        const ProjectedNode<D> &out = *nodeAt(*this, sIdx);
+        const ProjectedNode<D> &inp = *nodeAt(src, sIdx);
+        bool outChildren = out.isBranchNode() and not out.isEndNode();
+        bool inpChildren = inp.isBranchNode() and not inp.isEndNode();
+        if (outChildren != inpChildren or out.parentSerialIx != inp.parentSerialIx) return false;
+        if (outChildren and out.childSerialIx != inp.childSerialIx) return false;
+        if (out.getNodeIndex() != inp.getNodeIndex()) return false;
+    }
+
+    const int tDim = (1 << D);
+    const int nSlots = this->nNodes;
+#pragma omp parallel for schedule(static)
+    for (int sIdx = 0; sIdx < nSlots; sIdx++) {
+        if (this->nodeStackStatus[sIdx] == 0) continue;
+        ProjectedNode<D> &out = *nodeAt(*this, sIdx);
+        const ProjectedNode<D> &inp = *nodeAt(src, sIdx);
+        if (inp.hasCoefs()) {
+            std::copy(inp.coefs, inp.coefs + this->sizeNodeCoeff, out.coefs);
+            out.setHasCoefs();
+        } else {
+            out.clearHasCoefs();
+        }
+        out.squareNorm = inp.squareNorm;
+        for (int i = 0; i < tDim; i++) out.componentNorms[i] = inp.componentNorms[i];
+    }
+    this->getTree()->squareNorm = src.getTree()->getSquareNorm();
+    return true;
+}
+
+/** Release the memory of the packed topology arrays */
+template <int D> void SerialFunctionTree<D>::clearTopology() {
+    std::vector<unsigned char>().swap(this->topoStatus);
+    std::vector<short int>().swap(this->topoScale);
+    std::vector<int>().swap(this->topoTranslation);
+    std::vector<int>().swap(this->topoParentIx);
+    std::vector<int>().swap(this->topoChildIx);
+    std::vector<double>().swap(this->topoNorms);
 }
 
 template <int D> int SerialFunctionTree<D>::getNChunksUsed() const {
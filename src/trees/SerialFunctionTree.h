@@ -34,6 +34,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <vector>
 
 #include "SerialTree.h"
@@ -49,6 +51,7 @@ public:
 
     void allocRoots(MWTree<D> &tree) override;
     void allocChildren(MWNode<D> &parent) override;
+    void allocChildren(MWNodeVector<D> &parents) override;
     void allocGenChildren(MWNode<D> &parent) override;
 
     void deallocNodes(int serialIx) override;
@@ -59,43 +62,93 @@ public:
     int getNChunksUsed() const;
 
     int shrinkChunks();
+    int repack();
+
+    void setHugePages(bool enable);
+    bool getHugePages() const { return this->hugePages; }
+
+    void toSinglePrecision();
+    void toDoublePrecision();
+    bool isSinglePrecision() const { return this->singlePrecision; }
+    bool widenCoefs(const MWNode<D> &node, double *c) const;
+
+    std::map<int, int> getNumaPageCount() const;
+    void printNumaReport() const;
 
     std::vector<ProjectedNode<D> *> nodeChunks;
     std::vector<double *> nodeCoeffChunks;
+    std::vector<float *> nodeCoeffChunksSP; // single precision storage of nodeCoeffChunks
+    std::vector<char> nodeHasCoefsSP;       // FlagHasCoefs of each node while stored in single precision
 
     ProjectedNode<D> *sNodes; // serial ProjectedNodes
     GenNode<D> *sGenNodes;    // serial GenNodes
 
     std::vector<GenNode<D> *> genNodeChunks;
     std::vector<double *> genNodeCoeffChunks;
+    std::vector<int *> genNodeStatusChunks; // occupation status of each GenNode, one array per chunk
 
-    int nGenNodes; // number of GenNodes already defined
+    std::atomic<int> nGenNodes; // number of GenNodes currently in use
 
     double **genCoeffStack;
 
-    //    int *genNodeStackStatus;
-    std::vector<int> genNodeStackStatus;
+    // Packed topology of the ProjectedNodes (structure of arrays indexed by serialIx)
+    std::vector<unsigned char> topoStatus; // node status flags, zero for unused positions
+    std::vector<short int> topoScale;      // scale of NodeIndex
+    std::vector<int> topoTranslation;      // translation of NodeIndex, D entries per node
+    std::vector<int> topoParentIx;         // serialIx of parent, -1 for root nodes
+    std::vector<int> topoChildIx;          // serialIx of first child, -1 for leaf nodes
+    std::vector<double> topoNorms;         // squareNorm followed by the 2^D componentNorms
 
-    void rewritePointers();
+    void packTopology(int nChunks = -1);
+    void packTopology(SerialFunctionTree<D> &dst, int nChunks = -1) const;
+    void unpackTopology();
+    void clearTopology();
 
+    void copyTopology(const SerialFunctionTree<D> &src);
+    bool copyCoefs(SerialFunctionTree<D> &src);
+
+    void appendChunk();
     void clear(int n);
 
 protected:
     int maxGenNodes;      // max number of Gen nodes that can be defined
     int sizeGenNodeCoeff; // size of coeff for one Gen node
-
-    char *cvptr_ProjectedNode; // virtual table pointer for ProjectedNode
-    char *cvptr_GenNode;       // virtual table pointer for GenNode
+    bool hugePages;       // back new coefficient chunks with 2 MB pages
+    bool singlePrecision; // coefficients are stored in nodeCoeffChunksSP
 
     ProjectedNode<D> *lastNode; // pointer just after the last active node, i.e. where to put next node
-    GenNode<D> *lastGenNode;    // pointer just after the last active Gen node, i.e. where to put next node
 
     ProjectedNode<D> *allocNodes(int nAlloc, int *serialIx, double **coefs_p);
     GenNode<D> *allocGenNodes(int nAlloc, int *serialIx, double **coefs_p);
 
 private:
+    /** Per-thread GenNode arena. Each thread owns one GenNode chunk at a time and
+     * hands out consecutive sibling groups from it without any locking. Sibling
+     * groups that are deallocated are pushed back (by any thread) on the
+     * returnedGroups list of the owning arena, and recycled by the owner. */
+    struct GenNodeArena {
+        GenNode<D> *nodes{nullptr};                    // start of the owned chunk
+        double *coefs{nullptr};                        // coefficients of the owned chunk
+        int *status{nullptr};                          // occupation status of the owned chunk
+        int firstIx{0};                                // serial index of the first node in the chunk
+        int nextIx{0};                                 // next free position within the chunk
+        GenNode<D> *freeGroups{nullptr};               // recycled groups, only touched by the owner
+        std::atomic<GenNode<D> *> returnedGroups{nullptr}; // groups returned by deallocation
+    };
+    std::vector<GenNodeArena> genNodeArenas; // one arena per thread
+    std::vector<int> genNodeChunkOwner;      // index of the arena owning each GenNode chunk
+
+    std::vector<bool> nodeCoeffChunkHuge; // allocation mode of each coefficient chunk
+
+    void initChildren(MWNode<D> &parent, ProjectedNode<D> *child_p, int sIx, double *coefs_p);
+    void freeChunk(int iChunk);
+    void releaseChunk(ProjectedNode<D> *nodes, double *coefs, bool huge);
+    void claimGenNodeChunk(GenNodeArena &arena);
+    void freeGenNodeChunks();
+    void resetGenNodeArenas();
+
 #ifdef _OPENMP
-    omp_lock_t Sfunc_tree_lock;
+    omp_lock_t Sfunc_tree_lock; // protects the GenNode chunk tables, not the per-thread allocations
 #endif
 };
 
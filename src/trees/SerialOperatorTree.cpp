@@ -23,6 +23,8 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <new>
+
 #include "SerialOperatorTree.h"
 #include "OperatorNode.h"
 #include "OperatorTree.h"
@@ -57,11 +59,6 @@ SerialOperatorTree::SerialOperatorTree(OperatorTree *tree)
     this->maxNodesPerChunk = 1024;
     this->lastNode = (OperatorNode *)this->sNodes; // position of last allocated node
 
-    // make virtual table pointers
-    auto *tmpNode = new OperatorNode();
-    this->cvptr_OperatorNode = *(char **)(tmpNode);
-    delete tmpNode;
-
 #ifdef _OPENMP
     omp_init_lock(&Soper_tree_lock);
 #endif
@@ -93,7 +90,7 @@ void SerialOperatorTree::allocRoots(MWTree<2> &tree) {
     for (int rIdx = 0; rIdx < nRoots; rIdx++) {
         roots[rIdx] = root_p;
 
-        *(char **)(root_p) = this->cvptr_OperatorNode;
+        new (root_p) OperatorNode();
 
         root_p->tree = &tree;
         root_p->parent = nullptr;
@@ -105,7 +102,6 @@ void SerialOperatorTree::allocRoots(MWTree<2> &tree) {
         root_p->n_coefs = this->sizeNodeCoeff;
         root_p->coefs = coefs_p;
 
-        root_p->lockX = 0;
         root_p->serialIx = sIx;
         root_p->parentSerialIx = -1; // to indicate rootnode
         root_p->childSerialIx = -1;
@@ -140,7 +136,7 @@ void SerialOperatorTree::allocChildren(MWNode<2> &parent) {
     for (int cIdx = 0; cIdx < nChildren; cIdx++) {
         parent.children[cIdx] = child_p;
 
-        *(char **)(child_p) = this->cvptr_OperatorNode;
+        new (child_p) OperatorNode();
 
         child_p->tree = parent.tree;
         child_p->parent = &parent;
@@ -152,7 +148,6 @@ void SerialOperatorTree::allocChildren(MWNode<2> &parent) {
         child_p->n_coefs = this->sizeNodeCoeff;
         child_p->coefs = coefs_p;
 
-        child_p->lockX = 0;
         child_p->serialIx = sIx;
         child_p->parentSerialIx = parent.serialIx;
         child_p->childSerialIx = -1;
@@ -48,6 +48,7 @@ public:
     ~SerialOperatorTree() override;
 
     void allocRoots(MWTree<2> &tree) override;
+    using SerialTree<2>::allocChildren;
     void allocChildren(MWNode<2> &parent) override;
     void allocGenChildren(MWNode<2> &parent) override;
 
@@ -61,8 +62,7 @@ protected:
     std::vector<OperatorNode *> nodeChunks;
     std::vector<double *> nodeCoeffChunks;
 
-    char *cvptr_OperatorNode; // virtual table pointer for OperatorNode
-    OperatorNode *lastNode;   // pointer to the last active node
+    OperatorNode *lastNode; // pointer to the last active node
 
     OperatorNode *allocNodes(int nAlloc, int *serialIx, double **coefs_p);
 
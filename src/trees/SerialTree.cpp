@@ -48,6 +48,11 @@ SerialTree<D>::SerialTree(MWTree<D> *tree, SharedMemory *mem)
 #endif
 }
 
+/** Allocate the children of all nodes in the vector, in order */
+template <int D> void SerialTree<D>::allocChildren(MWNodeVector<D> &parents) {
+    for (auto *parent : parents) allocChildren(*parent);
+}
+
 /** Make children scaling coefficients from parent
  * Other node info are not used/set
  * coeff_in are not modified.
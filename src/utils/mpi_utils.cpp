@@ -22,6 +22,8 @@
  * For information on the complete list of contributors to MRCPP, see:
  * <https://mrcpp.readthedocs.io/>
  */
+#include <algorithm>
+#include <vector>
 
 #include "mpi_utils.h"
 #include "Printer.h"
@@ -68,6 +70,37 @@ SharedMemory::~SharedMemory() {
 #endif
 }
 
+#ifdef HAVE_MPI
+/** Send the packed topology arrays of a tree, see SerialFunctionTree::packTopology */
+template <int D> void send_topology(SerialFunctionTree<D> &sTree, int dst, int tag, MPI_Comm comm) {
+    int nSlots = sTree.topoStatus.size();
+    MPI_Send(sTree.topoStatus.data(), nSlots, MPI_UNSIGNED_CHAR, dst, tag + 1, comm);
+    MPI_Send(sTree.topoScale.data(), nSlots, MPI_SHORT, dst, tag + 2, comm);
+    MPI_Send(sTree.topoTranslation.data(), D * nSlots, MPI_INT, dst, tag + 3, comm);
+    MPI_Send(sTree.topoParentIx.data(), nSlots, MPI_INT, dst, tag + 4, comm);
+    MPI_Send(sTree.topoChildIx.data(), nSlots, MPI_INT, dst, tag + 5, comm);
+    MPI_Send(sTree.topoNorms.data(), sTree.topoNorms.size(), MPI_DOUBLE, dst, tag + 6, comm);
+}
+
+/** Receive the packed topology arrays of a tree covering nChunks chunks */
+template <int D> void recv_topology(SerialFunctionTree<D> &sTree, int nChunks, int src, int tag, MPI_Comm comm) {
+    MPI_Status status;
+    int nSlots = nChunks * sTree.maxNodesPerChunk;
+    sTree.topoStatus.resize(nSlots);
+    sTree.topoScale.resize(nSlots);
+    sTree.topoTranslation.resize(D * nSlots);
+    sTree.topoParentIx.resize(nSlots);
+    sTree.topoChildIx.resize(nSlots);
+    sTree.topoNorms.resize(((1 << D) + 1) * nSlots);
+    MPI_Recv(sTree.topoStatus.data(), nSlots, MPI_UNSIGNED_CHAR, src, tag + 1, comm, &status);
+    MPI_Recv(sTree.topoScale.data(), nSlots, MPI_SHORT, src, tag + 2, comm, &status);
+    MPI_Recv(sTree.topoTranslation.data(), D * nSlots, MPI_INT, src, tag + 3, comm, &status);
+    MPI_Recv(sTree.topoParentIx.data(), nSlots, MPI_INT, src, tag + 4, comm, &status);
+    MPI_Recv(sTree.topoChildIx.data(), nSlots, MPI_INT, src, tag + 5, comm, &status);
+    MPI_Recv(sTree.topoNorms.data(), sTree.topoNorms.size(), MPI_DOUBLE, src, tag + 6, comm, &status);
+}
+#endif
+
 /** @brief Send FunctionTree to a given MPI rank using blocking communication
  *
  *  @param[in] tree: FunctionTree to send
@@ -79,7 +112,8 @@ SharedMemory::~SharedMemory() {
  *  @details The number of memory chunks must be known before we can send the
  *  tree. This can be specified in the last argument if known a priori, in order
  *  to speed up communication, otherwise it will be communicated in a separate
- *  step before the main communication.
+ *  step before the main communication. The tree is sent as packed topology
+ *  arrays followed by the coefficient chunks, no node objects are transferred.
  */
 template <int D> void send_tree(FunctionTree<D> &tree, int dst, int tag, MPI_Comm comm, int nChunks) {
 #ifdef HAVE_MPI
@@ -93,12 +127,20 @@ template <int D> void send_tree(FunctionTree<D> &tree, int dst, int tag, MPI_Com
     }
 
     Timer t1;
-    int count = 1;
+    sTree.packTopology(nChunks);
+    send_topology(sTree, dst, tag, comm);
+    sTree.clearTopology();
+
+    int single = (sTree.isSinglePrecision()) ? 1 : 0;
+    MPI_Send(&single, 1, MPI_INT, dst, tag + 7, comm);
+
+    int count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
     for (int iChunk = 0; iChunk < nChunks; iChunk++) {
-        count = sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>);
-        MPI_Send(sTree.nodeChunks[iChunk], count, MPI_BYTE, dst, tag + iChunk + 1, comm);
-        count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
-        MPI_Send(sTree.nodeCoeffChunks[iChunk], count, MPI_DOUBLE, dst, tag + iChunk + 1001, comm);
+        if (single) {
+            MPI_Send(sTree.nodeCoeffChunksSP[iChunk], count, MPI_FLOAT, dst, tag + iChunk + 1001, comm);
+        } else {
+            MPI_Send(sTree.nodeCoeffChunks[iChunk], count, MPI_DOUBLE, dst, tag + iChunk + 1001, comm);
+        }
     }
     println(10, " Time send                   " << std::setw(30) << t1.elapsed());
 #endif
@@ -128,36 +170,30 @@ template <int D> void recv_tree(FunctionTree<D> &tree, int src, int tag, MPI_Com
     }
 
     Timer t1;
-    int count = 1;
+    tree.setSinglePrecision(false);
+    recv_topology(sTree, nChunks, src, tag, comm);
+
+    int single;
+    MPI_Recv(&single, 1, MPI_INT, src, tag + 7, comm, &status);
+
+    while (sTree.nodeChunks.size() < nChunks) sTree.appendChunk();
+    int count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
+    std::vector<float> buffer((single) ? count : 0);
     for (int iChunk = 0; iChunk < nChunks; iChunk++) {
-        if (iChunk < sTree.nodeChunks.size()) {
-            sTree.sNodes = sTree.nodeChunks[iChunk];
+        if (single) {
+            // single precision coefficients are widened on the fly
+            MPI_Recv(buffer.data(), count, MPI_FLOAT, src, tag + iChunk + 1001, comm, &status);
+            std::copy(buffer.begin(), buffer.end(), sTree.nodeCoeffChunks[iChunk]);
         } else {
-            double *sNodesCoeff;
-            if (sTree.isShared()) {
-                // for coefficients, take from the shared memory block
-                SharedMemory *shMem = sTree.getMemory();
-                sNodesCoeff = shMem->sh_end_ptr;
-                shMem->sh_end_ptr += (sTree.sizeNodeCoeff * sTree.maxNodesPerChunk);
-                // may increase size dynamically in the future
-                if (shMem->sh_max_ptr < shMem->sh_end_ptr) MSG_ABORT("Shared block too small");
-            } else {
-                sNodesCoeff = new double[sTree.sizeNodeCoeff * sTree.maxNodesPerChunk];
-            }
-            sTree.nodeCoeffChunks.push_back(sNodesCoeff);
-            sTree.sNodes = (ProjectedNode<D> *)new char[sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>)];
-            sTree.nodeChunks.push_back(sTree.sNodes);
+            MPI_Recv(sTree.nodeCoeffChunks[iChunk], count, MPI_DOUBLE, src, tag + iChunk + 1001, comm, &status);
         }
-        count = sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>);
-        MPI_Recv(sTree.nodeChunks[iChunk], count, MPI_BYTE, src, tag + iChunk + 1, comm, &status);
-        count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
-        MPI_Recv(sTree.nodeCoeffChunks[iChunk], count, MPI_DOUBLE, src, tag + iChunk + 1001, comm, &status);
     }
     println(10, " Time receive                " << std::setw(30) << t1.elapsed());
 
     Timer t2;
-    sTree.rewritePointers();
-    println(10, " Time rewrite pointers       " << std::setw(30) << t2.elapsed());
+    sTree.unpackTopology();
+    sTree.clearTopology();
+    println(10, " Time unpack topology        " << std::setw(30) << t2.elapsed());
 #endif
 }
 
@@ -169,7 +205,8 @@ template <int D> void recv_tree(FunctionTree<D> &tree, int src, int tag, MPI_Com
  *  @param[in] comm: Communicator that defines ranks
  *
  *  @details This function should be called every time a shared function is
- *  updated, in order to update the local memory of each MPI process.
+ *  updated, in order to update the local memory of each MPI process. Only the
+ *  packed topology is communicated, the coefficients are already in place.
  */
 template <int D> void share_tree(FunctionTree<D> &tree, int src, int tag, MPI_Comm comm) {
 #ifdef HAVE_MPI
@@ -181,6 +218,7 @@ template <int D> void share_tree(FunctionTree<D> &tree, int src, int tag, MPI_Co
     MPI_Comm_size(comm, &size);
     MPI_Comm_rank(comm, &rank);
 
+    if (rank == src) sTree.packTopology(sTree.getNChunks());
     for (int dst = 0; dst < size; dst++) {
         if (dst == src) continue;
         int dst_tag = tag * (dst + 1);
@@ -188,13 +226,7 @@ template <int D> void share_tree(FunctionTree<D> &tree, int src, int tag, MPI_Co
             int nChunks = sTree.nodeChunks.size();
             println(10, " Sending " << nChunks << " chunks");
             MPI_Send(&nChunks, sizeof(int), MPI_BYTE, dst, dst_tag, comm);
-            int count = 1;
-            for (int iChunk = 0; iChunk < nChunks; iChunk++) {
-                count = sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>);
-                println(10, " Sending chunk " << iChunk);
-                MPI_Send(sTree.nodeChunks[iChunk], count, MPI_BYTE, dst, dst_tag + iChunk + 1, comm);
-                count = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk;
-            }
+            send_topology(sTree, dst, dst_tag, comm);
         }
         if (rank == dst) {
             MPI_Status status;
@@ -203,25 +235,14 @@ template <int D> void share_tree(FunctionTree<D> &tree, int src, int tag, MPI_Co
             MPI_Recv(&nChunks, sizeof(int), MPI_BYTE, src, dst_tag, comm, &status);
             println(10, " Received " << nChunks << " chunks");
 
-            int count = 1;
-            for (int iChunk = 0; iChunk < nChunks; iChunk++) {
-                if (iChunk < sTree.nodeChunks.size()) {
-                    sTree.sNodes = sTree.nodeChunks[iChunk];
-                } else {
-                    if (iChunk == 0) sTree.getMemory()->sh_end_ptr = sTree.getMemory()->sh_start_ptr;
-                    double *sNodesCoeff = sTree.getMemory()->sh_end_ptr;
-                    sTree.getMemory()->sh_end_ptr += (sTree.sizeNodeCoeff * sTree.maxNodesPerChunk);
-                    sTree.nodeCoeffChunks.push_back(sNodesCoeff);
-                    sTree.sNodes = (ProjectedNode<D> *)new char[sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>)];
-                    sTree.nodeChunks.push_back(sTree.sNodes);
-                }
-                count = sTree.maxNodesPerChunk * sizeof(ProjectedNode<D>);
-                println(10, " Receiving chunk " << iChunk);
-                MPI_Recv(sTree.nodeChunks[iChunk], count, MPI_BYTE, src, dst_tag + iChunk + 1, comm, &status);
-            }
-            sTree.rewritePointers();
+            // coefficient chunks are laid out in the shared block in the same order as on src
+            if (sTree.nodeChunks.size() == 0) sTree.getMemory()->sh_end_ptr = sTree.getMemory()->sh_start_ptr;
+            while (sTree.nodeChunks.size() < nChunks) sTree.appendChunk();
+            recv_topology(sTree, nChunks, src, dst_tag, comm);
+            sTree.unpackTopology();
         }
     }
+    sTree.clearTopology();
     println(10, " Time share                  " << std::setw(30) << t1.elapsed());
 #endif
 }
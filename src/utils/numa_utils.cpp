@@ -0,0 +1,139 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Printer.h"
+#include "numa_utils.h"
+
+namespace mrcpp {
+
+namespace {
+const std::size_t hugePageSize = 2 * 1024 * 1024;
+const std::size_t minMappedPages = 16; // smaller chunks come from the heap
+const std::size_t heapAlignment = 64;  // cache line
+
+/** Whether a chunk of nDoubles is mapped directly, or taken from the heap */
+bool is_mapped(int nDoubles, bool hugePages) {
+    return hugePages or (nDoubles * sizeof(double) >= minMappedPages * numa_utils::get_page_size());
+}
+
+/** Size of the mapping holding nDoubles, rounded up to whole pages */
+std::size_t chunk_bytes(int nDoubles, bool hugePages) {
+    std::size_t align = (hugePages) ? hugePageSize : numa_utils::get_page_size();
+    std::size_t bytes = nDoubles * sizeof(double);
+    return ((bytes + align - 1) / align) * align;
+}
+} // namespace
+
+/** Size of a (small) memory page in bytes */
+int numa_utils::get_page_size() {
+#ifdef __linux__
+    static const int pageSize = sysconf(_SC_PAGESIZE);
+    return pageSize;
+#else
+    return 4096;
+#endif
+}
+
+/** Allocate a chunk of nDoubles on fresh pages that are not touched.
+ * With hugePages the chunk is aligned on a 2 MB boundary and the kernel is
+ * advised to back it with transparent huge pages. The whole huge page is then
+ * placed by the first touching thread. Chunks smaller than a few pages are
+ * taken from the heap (cache line aligned) to avoid a system call and a
+ * partly used page per chunk. Falls back to new[] on non-Linux systems.
+ */
+double *numa_utils::alloc_chunk(int nDoubles, bool hugePages) {
+#ifdef __linux__
+    if (not is_mapped(nDoubles, hugePages)) {
+        void *p = nullptr;
+        if (posix_memalign(&p, heapAlignment, nDoubles * sizeof(double)) != 0) MSG_ABORT("Chunk allocation failed");
+        return static_cast<double *>(p);
+    }
+    std::size_t bytes = chunk_bytes(nDoubles, hugePages);
+    std::size_t extra = (hugePages) ? hugePageSize : 0; // slack for the alignment
+    void *p = mmap(nullptr, bytes + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) MSG_ABORT("Chunk allocation failed");
+
+    auto *start = static_cast<char *>(p);
+    if (hugePages) {
+        // trim the mapping down to the aligned part
+        std::size_t head = (hugePageSize - reinterpret_cast<std::uintptr_t>(start) % hugePageSize) % hugePageSize;
+        if (head > 0) munmap(start, head);
+        if (extra > head) munmap(start + head + bytes, extra - head);
+        start += head;
+#ifdef MADV_HUGEPAGE
+        madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    return reinterpret_cast<double *>(start);
+#else
+    return new double[nDoubles];
+#endif
+}
+
+/** Release a chunk allocated by alloc_chunk, with the same size and mode */
+void numa_utils::free_chunk(double *chunk, int nDoubles, bool hugePages) {
+    if (chunk == nullptr) return;
+#ifdef __linux__
+    if (is_mapped(nDoubles, hugePages)) {
+        munmap(chunk, chunk_bytes(nDoubles, hugePages));
+    } else {
+        free(chunk);
+    }
+#else
+    delete[] chunk;
+#endif
+}
+
+/** Add the number of pages of the chunk residing in each NUMA domain to the
+ * map. Pages that have not been touched yet are counted with domain -1. The
+ * map is left unchanged if the placement cannot be queried on this system.
+ */
+void numa_utils::count_pages(const double *chunk, int nDoubles, std::map<int, int> &pages) {
+#if defined(__linux__) && defined(SYS_move_pages)
+    const std::size_t pageSize = get_page_size();
+    const auto *start = reinterpret_cast<const char *>(chunk);
+    const std::size_t nPages = (nDoubles * sizeof(double) + pageSize - 1) / pageSize;
+
+    std::vector<void *> addr(nPages);
+    std::vector<int> status(nPages, -1);
+    for (std::size_t i = 0; i < nPages; i++) addr[i] = const_cast<char *>(start + i * pageSize);
+
+    // with no target nodes, move_pages only reports the current placement
+    if (syscall(SYS_move_pages, 0, nPages, addr.data(), nullptr, status.data(), 0) != 0) return;
+    for (int s : status) pages[(s < 0) ? -1 : s]++;
+#endif
+}
+
+} // namespace mrcpp
@@ -0,0 +1,50 @@
+/*
+ * MRCPP, a numerical library based on multiresolution analysis and
+ * the multiwavelet basis which provide low-scaling algorithms as well as
+ * rigorous error control in numerical computations.
+ * Copyright (C) 2020 Stig Rune Jensen, Jonas Juselius, Luca Frediani and contributors.
+ *
+ * This file is part of MRCPP.
+ *
+ * MRCPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRCPP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRCPP.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRCPP, see:
+ * <https://mrcpp.readthedocs.io/>
+ */
+
+/* \file numa_utils.h
+ *
+ * \brief Page level allocation of coefficient chunks and NUMA placement queries.
+ *
+ * Coefficient chunks are mapped directly from the kernel, so their pages are
+ * guaranteed to be untouched on allocation: each page is placed in the NUMA
+ * domain of the thread that first writes to it, i.e. the thread computing
+ * the nodes living on that page. Small chunks are taken from the heap.
+ */
+
+#pragma once
+
+#include <map>
+
+namespace mrcpp {
+namespace numa_utils {
+
+double *alloc_chunk(int nDoubles, bool hugePages = false);
+void free_chunk(double *chunk, int nDoubles, bool hugePages = false);
+
+void count_pages(const double *chunk, int nDoubles, std::map<int, int> &pages);
+int get_page_size();
+
+} // namespace numa_utils
+} // namespace mrcpp
@@ -30,6 +30,7 @@
 #include "operators/HelmholtzKernel.h"
 #include "operators/HelmholtzOperator.h"
 #include "operators/MWOperator.h"
+#include "operators/OperatorCache.h"
 #include "treebuilders//OperatorAdaptor.h"
 #include "treebuilders/CrossCorrelationCalculator.h"
 #include "treebuilders/TreeBuilder.h"
@@ -199,6 +200,78 @@ TEST_CASE("Apply Helmholtz' operator", "[apply_helmholtz], [helmholtz_operator],
     REQUIRE(error == Approx(0.0).margin(apply_prec));
 }
 
+TEST_CASE("Helmholtz' operator from the operator cache", "[operator_cache], [helmholtz_operator], [mw_operator]") {
+    double build_prec = 1.0e-3;
+
+    int scale = -4;
+    std::array<int, 3> corner;
+    std::array<int, 3> nbox;
+    corner.fill(-1);
+    nbox.fill(2);
+    BoundingBox<3> box(scale, corner, nbox);
+    InterpolatingBasis basis(5);
+    MultiResolutionAnalysis<3> MRA(box, basis);
+
+    getOperatorCache(cache);
+    cache.setEnabled(true);
+
+    double mu = 1.0;
+    HelmholtzOperator H_1(MRA, mu, build_prec);
+    REQUIRE(cache.getNTrees() == H_1.size());
+    REQUIRE(cache.getNMisses() == H_1.size());
+    REQUIRE(cache.getNHits() == 0);
+    REQUIRE(cache.getMem() > 0);
+
+    SECTION("Identical parameters share the trees") {
+        HelmholtzOperator H_2(MRA, mu, build_prec);
+        REQUIRE(H_2.size() == H_1.size());
+        REQUIRE(cache.getNHits() == H_1.size());
+        for (int i = 0; i < H_1.size(); i++) { REQUIRE(&H_2.getComponent(i) == &H_1.getComponent(i)); }
+    }
+
+    SECTION("Nearby parameters give rescaled copies") {
+        // Exponents scale with mu^2 and coefficients with mu
+        double mu_3 = mu * (1.0 + 1.0e-7);
+        cache.setTolerance(1.0e-6);
+        HelmholtzOperator H_3(MRA, mu_3, build_prec);
+        REQUIRE(H_3.size() == H_1.size());
+        REQUIRE(cache.getNHits() == H_1.size());
+        double ratio = std::pow(mu_3 / mu, 2.0 / 3.0);
+        for (int i = 0; i < H_1.size(); i++) {
+            const OperatorTree &o_1 = H_1.getComponent(i);
+            const OperatorTree &o_3 = H_3.getComponent(i);
+            REQUIRE(&o_3 != &o_1);
+            REQUIRE(o_3.getNNodes() == o_1.getNNodes());
+            REQUIRE(o_3.getSquareNorm() == Approx(ratio * o_1.getSquareNorm()).epsilon(1.0e-12));
+        }
+        cache.setTolerance(0.0);
+    }
+
+    SECTION("Clearing an operator does not delete the shared trees") {
+        HelmholtzOperator H_2(MRA, mu, build_prec);
+        double sq_norm = H_1.getComponent(0).getSquareNorm();
+        H_2.clear(true);
+        REQUIRE(H_2.size() == 0);
+        REQUIRE(cache.getNTrees() == H_1.size());
+        REQUIRE(H_1.getComponent(0).getSquareNorm() == Approx(sq_norm));
+    }
+
+    SECTION("Eviction does not invalidate operators") {
+        double sq_norm = H_1.getComponent(0).getSquareNorm();
+        cache.setMemoryLimit(0);
+        REQUIRE(cache.getNTrees() == 0);
+        REQUIRE(cache.getMem() == 0);
+        REQUIRE(H_1.getComponent(0).getSquareNorm() == Approx(sq_norm));
+
+        HelmholtzOperator H_4(MRA, mu, build_prec);
+        REQUIRE(cache.getNTrees() == 0);
+        cache.setMemoryLimit(1024 * 1024);
+    }
+
+    cache.setEnabled(false);
+    REQUIRE(cache.getNTrees() == 0);
+}
+
 TEST_CASE("Apply Periodic Helmholtz' operator", "[apply_periodic_helmholtz], [helmholtz_operator], [mw_operator]") {
     double proj_prec = 3.0e-3;
     double apply_prec = 3.0e-2;
@@ -23,6 +23,8 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <fstream>
+
 #include "catch.hpp"
 
 #include "factory_functions.h"
@@ -31,14 +33,17 @@
 #include "operators/MWOperator.h"
 #include "operators/PoissonKernel.h"
 #include "operators/PoissonOperator.h"
+#include "treebuilders/ConvolutionCalculator.h"
 #include "treebuilders/CrossCorrelationCalculator.h"
 #include "treebuilders/OperatorAdaptor.h"
 #include "treebuilders/TreeBuilder.h"
+#include "treebuilders/add.h"
 #include "treebuilders/apply.h"
 #include "treebuilders/grid.h"
 #include "treebuilders/multiply.h"
 #include "treebuilders/project.h"
 #include "trees/BandWidth.h"
+#include "trees/OperatorNode.h"
 
 using namespace mrcpp;
 
@@ -125,6 +130,22 @@ TEST_CASE("Initialize Poisson operator", "[init_poisson], [poisson_operator], [m
                 REQUIRE(O.getMaxBandWidth(13) == 9);
                 REQUIRE(O.getMaxBandWidth(19) == -1);
 
+                O.calcReducedTerms(band_prec, 3);
+                REQUIRE(O.hasReducedTerms());
+                int nReduced = 0;
+                for (int depth = 0; depth < O.getMaxBandWidths().size(); depth++) {
+                    const auto &terms = O.getReducedTerms(depth);
+                    REQUIRE(terms.size() <= O.size());
+                    for (const auto &term : terms) {
+                        REQUIRE(O.getComponent(term.comp).getBandWidth().getMaxWidth(depth) >= 0);
+                        REQUIRE(term.coef >= 1.0);
+                    }
+                    nReduced += O.size() - terms.size();
+                }
+                REQUIRE(nReduced > 0);
+                O.clearReducedTerms();
+                REQUIRE_FALSE(O.hasReducedTerms());
+
                 O.clear(true);
             }
             clear(kern_vec, true);
@@ -159,6 +180,113 @@ TEST_CASE("Apply Poisson's operator", "[apply_poisson], [poisson_operator], [mw_
     finalize(&mra);
 }
 
+TEST_CASE("Apply Poisson's operator with different kernels", "[apply_poisson_kernels], [poisson_operator], [mw_operator]") {
+    double proj_prec = 1.0e-4;
+    double apply_prec = 1.0e-3;
+    double build_prec = 1.0e-4;
+
+    MultiResolutionAnalysis<3> *mra = nullptr;
+    GaussFunc<3> *fFunc = nullptr;
+
+    initialize(&fFunc);
+    initialize(&mra);
+
+    PoissonOperator P(*mra, build_prec);
+    FunctionTree<3> fTree(*mra);
+    project(proj_prec, fTree, *fFunc);
+
+    FunctionTree<3> gRef(*mra);
+    apply(apply_prec, gRef, P, fTree);
+    double E_ref = dot(gRef, fTree);
+
+    SECTION("Input nodes looked up through a hash table") {
+        REQUIRE_FALSE(fTree.hasNodeHashTable()); // apply removes its temporary table
+        fTree.makeNodeHashTable();
+        FunctionTree<3> gTree(*mra);
+        apply(apply_prec, gTree, P, fTree);
+        REQUIRE(fTree.hasNodeHashTable());
+        fTree.deleteNodeHashTable();
+        REQUIRE(gTree.getNNodes() == gRef.getNNodes());
+        REQUIRE(dot(gTree, fTree) == Approx(E_ref).epsilon(1.0e-12));
+    }
+
+    for (auto kernel : {ConvolutionKernel::FixedSize, ConvolutionKernel::Batched}) {
+        set_convolution_kernel(kernel);
+        FunctionTree<3> gTree(*mra);
+        apply(apply_prec, gTree, P, fTree);
+        set_convolution_kernel(ConvolutionKernel::Generic);
+
+        REQUIRE(gTree.getNNodes() == gRef.getNNodes());
+        REQUIRE(dot(gTree, fTree) == Approx(E_ref).epsilon(1.0e-12));
+
+        FunctionTree<3> diff(*mra);
+        add(-1.0, diff, 1.0, gTree, -1.0, gRef);
+        REQUIRE(diff.getSquareNorm() < 1.0e-20 * gRef.getSquareNorm());
+    }
+
+    finalize(&fFunc);
+    finalize(&mra);
+}
+
+TEST_CASE("Save and load Poisson's operator", "[operator_io], [poisson_operator], [mw_operator]") {
+    double proj_prec = 1.0e-4;
+    double apply_prec = 1.0e-3;
+    double build_prec = 1.0e-4;
+
+    MultiResolutionAnalysis<3> *mra = nullptr;
+    GaussFunc<3> *fFunc = nullptr;
+
+    initialize(&fFunc);
+    initialize(&mra);
+
+    PoissonOperator P(*mra, build_prec);
+    P.saveOperator("poisson");
+
+    ConvolutionOperator<3> Q(*mra, build_prec);
+    Q.loadOperator("poisson");
+    REQUIRE(Q.size() == P.size());
+    for (int i = 0; i < P.size(); i++) {
+        const OperatorTree &p_tree = P.getComponent(i);
+        const OperatorTree &q_tree = Q.getComponent(i);
+        REQUIRE(q_tree.getNNodes() == p_tree.getNNodes());
+        REQUIRE(q_tree.getDepth() == p_tree.getDepth());
+        REQUIRE(q_tree.getSquareNorm() == p_tree.getSquareNorm());
+        int depth = p_tree.getDepth() - 1;
+        REQUIRE(q_tree.getNode(depth, 0).getComponentNorm(0) == p_tree.getNode(depth, 0).getComponentNorm(0));
+    }
+
+    // The header of a stored component records the world box
+    P.getComponent(0).saveTree("poisson_0");
+    std::ifstream f("poisson_0.tree", std::ios::binary);
+    OperatorTreeHeader header{};
+    f.read((char *)&header, sizeof(OperatorTreeHeader));
+    const BoundingBox<2> &box = P.getComponent(0).getMRA().getWorldBox();
+    for (int d = 0; d < 2; d++) {
+        REQUIRE(header.corner[d] == box.getCornerIndex().getTranslation(d));
+        REQUIRE(header.nBoxes[d] == box.size(d));
+        REQUIRE(header.scaling[d] == box.getScalingFactor(d));
+    }
+    f.close();
+    remove("poisson_0.tree");
+
+    FunctionTree<3> fTree(*mra);
+    project(proj_prec, fTree, *fFunc);
+
+    FunctionTree<3> gRef(*mra);
+    apply(apply_prec, gRef, P, fTree);
+
+    FunctionTree<3> gTree(*mra);
+    apply(apply_prec, gTree, Q, fTree);
+    REQUIRE(gTree.getNNodes() == gRef.getNNodes());
+    REQUIRE(dot(gTree, fTree) == dot(gRef, fTree));
+
+    // Delete saved file
+    remove("poisson.oper");
+
+    finalize(&mra);
+    finalize(&fFunc);
+}
+
 TEST_CASE("Apply Periodic Poisson' operator", "[apply_periodic_Poisson], [poisson_operator], [mw_operator]") {
     double proj_prec = 3.0e-3;
     double apply_prec = 3.0e-2;
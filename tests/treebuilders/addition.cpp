@@ -118,6 +118,17 @@ template <int D> void testAddition() {
             REQUIRE(c_norm == Approx(ref_norm));
         }
 
+        AND_WHEN("the functions are added with one of them stored in single precision") {
+            FunctionTree<D> d_tree(*mra);
+            b_tree.setSinglePrecision(true);
+            add(prec, d_tree, a_coef, a_tree, b_coef, b_tree);
+
+            THEN("the sum equals the double precision sum") {
+                REQUIRE(d_tree.integrate() == Approx(c_tree.integrate()));
+                REQUIRE(dot(d_tree, c_tree) == Approx(c_tree.getSquareNorm()));
+            }
+        }
+
         AND_WHEN("the first function is subtracted") {
             FunctionTree<D> d_tree(*mra);
             sum_vec.push_back(std::make_tuple(1.0, &c_tree));
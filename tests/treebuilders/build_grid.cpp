@@ -28,6 +28,9 @@
 #include "factory_functions.h"
 
 #include "treebuilders/grid.h"
+#include "treebuilders/project.h"
+#include "trees/MWNode.h"
+#include "utils/omp_utils.h"
 
 using namespace mrcpp;
 
@@ -94,6 +97,60 @@ template <int D> void testBuildGrid() {
             }
         }
     }
+    WHEN("a projected function is given to copy_grid") {
+        FunctionTree<D> f_tree(*mra);
+        project(1.0e-3, f_tree, *f_func);
+
+        Coord<D> r;
+        if (r.size() >= 1) r[0] = -0.21;
+        if (r.size() >= 2) r[1] = 0.49;
+        if (r.size() >= 3) r[2] = 1.01;
+        f_tree.getNode(r, f_tree.getDepth() + 1); // GenNodes are not copied
+
+        FunctionTree<D> g_tree(*mra);
+        build_grid(g_tree, *f_func, 1);
+        copy_grid(g_tree, f_tree);
+
+        THEN("we get an identical empty grid") {
+            REQUIRE(g_tree.getSquareNorm() == Approx(-1.0));
+            REQUIRE(g_tree.getDepth() == f_tree.getDepth());
+            REQUIRE(g_tree.getNNodes() == f_tree.getNNodes());
+            REQUIRE(g_tree.getNEndNodes() == f_tree.getNEndNodes());
+            REQUIRE(g_tree.getNGenNodes() == 0);
+
+            AND_WHEN("the function is copied onto the grid") {
+                copy_func(g_tree, f_tree);
+                THEN("the copy is identical") {
+                    REQUIRE(g_tree.getSquareNorm() == Approx(f_tree.getSquareNorm()).epsilon(1.0e-12));
+                    REQUIRE(g_tree.integrate() == Approx(f_tree.integrate()).epsilon(1.0e-12));
+                    REQUIRE(g_tree.evalf(r) == Approx(f_tree.evalf(r)).epsilon(1.0e-12));
+                }
+            }
+        }
+    }
+    WHEN("the analytic function is given to the GridGenerator with one and several threads") {
+        FunctionTree<D> f_tree(*mra);
+        FunctionTree<D> g_tree(*mra);
+#ifdef _OPENMP
+        int nThreads = omp_get_max_threads();
+        omp_set_num_threads(1);
+        build_grid(f_tree, *f_func);
+        omp_set_num_threads(nThreads);
+#else
+        build_grid(f_tree, *f_func);
+#endif
+        build_grid(g_tree, *f_func);
+        THEN("the nodes are laid out identically in memory") {
+            REQUIRE(g_tree.getNNodes() == f_tree.getNNodes());
+            REQUIRE(g_tree.getNEndNodes() == f_tree.getNEndNodes());
+            for (int i = 0; i < f_tree.getNEndNodes(); i++) {
+                const MWNode<D> &f_node = f_tree.getEndMWNode(i);
+                const MWNode<D> &g_node = g_tree.getEndMWNode(i);
+                REQUIRE(g_node.getNodeIndex() == f_node.getNodeIndex());
+                REQUIRE(g_node.getSerialIx() == f_node.getSerialIx());
+            }
+        }
+    }
     finalize(&mra);
     finalize(&f_func);
 }
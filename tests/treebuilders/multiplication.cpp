@@ -29,9 +29,11 @@
 
 #include "functions/GaussPoly.h"
 #include "treebuilders/WaveletAdaptor.h"
+#include "treebuilders/add.h"
 #include "treebuilders/grid.h"
 #include "treebuilders/multiply.h"
 #include "treebuilders/project.h"
+#include "utils/omp_utils.h"
 
 using namespace mrcpp;
 
@@ -39,6 +41,8 @@ namespace multiplication {
 
 template <int D> void testMultiplication();
 template <int D> void testSquare();
+template <int D> void testDot();
+template <int D> void testSumOfProducts();
 
 SCENARIO("Multiplying MW trees", "[multiplication], [tree_builder]") {
     GIVEN("Two MW functions in 1D") { testMultiplication<1>(); }
@@ -46,6 +50,18 @@ SCENARIO("Multiplying MW trees", "[multiplication], [tree_builder]") {
     GIVEN("Two MW functions in 3D") { testMultiplication<3>(); }
 }
 
+SCENARIO("Dot product of MW trees", "[dot], [multiplication], [tree_builder]") {
+    GIVEN("Two MW functions in 1D") { testDot<1>(); }
+    GIVEN("Two MW functions in 2D") { testDot<2>(); }
+    GIVEN("Two MW functions in 3D") { testDot<3>(); }
+}
+
+SCENARIO("Sum of products of MW trees", "[sum_of_products], [multiplication], [tree_builder]") {
+    GIVEN("Three MW functions in 1D") { testSumOfProducts<1>(); }
+    GIVEN("Three MW functions in 2D") { testSumOfProducts<2>(); }
+    GIVEN("Three MW functions in 3D") { testSumOfProducts<3>(); }
+}
+
 template <int D> void testMultiplication() {
     const double prec = 1.0e-4;
 
@@ -100,6 +116,18 @@ template <int D> void testMultiplication() {
             REQUIRE(c_norm == Approx(ref_norm));
         }
     }
+    WHEN("the functions are multiplied with one of them stored in single precision") {
+        FunctionTree<D> c_tree(*mra);
+        a_tree.setSinglePrecision(true);
+        multiply(prec, c_tree, 1.0, a_tree, b_tree);
+
+        THEN("the MW product equals the analytic product") {
+            REQUIRE(a_tree.isSinglePrecision());
+            REQUIRE(c_tree.integrate() == Approx(ref_int));
+            REQUIRE(dot(c_tree, ref_tree) == Approx(ref_norm));
+            REQUIRE(c_tree.getSquareNorm() == Approx(ref_norm));
+        }
+    }
     WHEN("the functions are multiplied in-place") {
         a_tree.multiply(1.0, b_tree);
 
@@ -175,6 +203,19 @@ template <int D> void testSquare() {
             REQUIRE(f_norm == Approx(ref_norm));
         }
     }
+    WHEN("the function is multiplied by itself") {
+        FunctionTree<D> ff_tree(*mra);
+        multiply(prec, ff_tree, 2.0, f_tree, f_tree);
+
+        THEN("the MW product equals twice the analytic square") {
+            double ff_int = ff_tree.integrate();
+            double ff_dot = dot(ff_tree, ref_tree);
+            double ff_norm = ff_tree.getSquareNorm();
+            REQUIRE(ff_int == Approx(2.0 * ref_int));
+            REQUIRE(ff_dot == Approx(2.0 * ref_norm));
+            REQUIRE(ff_norm == Approx(4.0 * ref_norm));
+        }
+    }
     WHEN("the function is raised to the second power out-of-place") {
         FunctionTree<D> ff_tree(*mra);
         power(prec, ff_tree, f_tree, 2.0);
@@ -254,4 +295,146 @@ TEST_CASE("Dot product FunctionTreeVectors", "[multiplication], [tree_vector_dot
     finalize(&mra);
 }
 
+template <int D> void testDot() {
+    const double prec = 1.0e-4;
+
+    double alpha = 1.0;
+    double beta_a = 110.0;
+    double beta_b = 50.0;
+
+    double pos_c_a[3] = {-0.25, 0.35, 1.05};
+    auto pos_a = details::convert_to_std_array<double, D>(pos_c_a);
+    double pos_c_b[3] = {-0.20, 0.50, 1.05};
+    auto pos_b = details::convert_to_std_array<double, D>(pos_c_b);
+
+    GaussFunc<D> a_func(beta_a, alpha, pos_a);
+    GaussFunc<D> b_func(beta_b, alpha, pos_b);
+    GaussPoly<D> ref_func = a_func * b_func;
+
+    MultiResolutionAnalysis<D> *mra = nullptr;
+    initialize<D>(&mra);
+
+    FunctionTree<D> a_tree(*mra);
+    FunctionTree<D> b_tree(*mra);
+    FunctionTree<D> ref_tree(*mra);
+    project(prec, a_tree, a_func);
+    project(prec, b_tree, b_func);
+    build_grid(ref_tree, ref_func);
+    project(prec, ref_tree, ref_func);
+
+    WHEN("the dot product is computed on different grids") {
+        double ab_dot = dot(a_tree, b_tree);
+        double ba_dot = dot(b_tree, a_tree);
+        THEN("it equals the integral of the product") {
+            REQUIRE(ab_dot == Approx(ref_tree.integrate()));
+            REQUIRE(ba_dot == Approx(ab_dot));
+        }
+        THEN("the result is independent of the number of threads") {
+#ifdef _OPENMP
+            int nThreads = omp_get_max_threads();
+            omp_set_num_threads(1);
+            double ab_serial = dot(a_tree, b_tree);
+            omp_set_num_threads(3);
+            double ab_three = dot(a_tree, b_tree);
+            omp_set_num_threads(nThreads);
+            REQUIRE(ab_dot == ab_serial);
+            REQUIRE(ab_dot == ab_three);
+#endif
+        }
+    }
+    WHEN("the overlap matrix of a vector of functions is computed") {
+        FunctionTreeVector<D> vec;
+        vec.push_back(std::make_tuple(1.0, &a_tree));
+        vec.push_back(std::make_tuple(2.0, &b_tree));
+        vec.push_back(std::make_tuple(-1.0, &ref_tree));
+        Eigen::MatrixXd S = calc_overlap_matrix(vec);
+        THEN("it equals the matrix of dot products") {
+            for (int i = 0; i < vec.size(); i++) {
+                for (int j = 0; j < vec.size(); j++) {
+                    double c_ij = get_coef(vec, i) * get_coef(vec, j);
+                    double ref_ij = c_ij * dot(get_func(vec, i), get_func(vec, j));
+                    REQUIRE(S(i, j) == Approx(ref_ij).epsilon(1.0e-12));
+                }
+            }
+        }
+        AND_WHEN("the overlap matrix with a second vector is computed") {
+            FunctionTreeVector<D> ket;
+            ket.push_back(std::make_tuple(1.0, &ref_tree));
+            ket.push_back(std::make_tuple(1.0, &a_tree));
+            Eigen::MatrixXd T = calc_overlap_matrix(vec, ket);
+            THEN("it equals the matrix of dot products") {
+                REQUIRE(T.rows() == 3);
+                REQUIRE(T.cols() == 2);
+                for (int i = 0; i < vec.size(); i++) {
+                    for (int j = 0; j < ket.size(); j++) {
+                        double c_ij = get_coef(vec, i) * get_coef(ket, j);
+                        double ref_ij = c_ij * dot(get_func(vec, i), get_func(ket, j));
+                        REQUIRE(T(i, j) == Approx(ref_ij).epsilon(1.0e-12));
+                    }
+                }
+            }
+        }
+    }
+    finalize(&mra);
+}
+
+template <int D> void testSumOfProducts() {
+    const double prec = 1.0e-4;
+
+    double alpha = 1.0;
+    double beta_a = 110.0;
+    double beta_b = 50.0;
+
+    double pos_c_a[3] = {-0.25, 0.35, 1.05};
+    auto pos_a = details::convert_to_std_array<double, D>(pos_c_a);
+    double pos_c_b[3] = {-0.20, 0.50, 1.05};
+    auto pos_b = details::convert_to_std_array<double, D>(pos_c_b);
+
+    GaussFunc<D> a_func(beta_a, alpha, pos_a);
+    GaussFunc<D> b_func(beta_b, alpha, pos_b);
+    GaussPoly<D> ab_func = a_func * b_func;
+
+    MultiResolutionAnalysis<D> *mra = nullptr;
+    initialize<D>(&mra);
+
+    FunctionTree<D> a_tree(*mra);
+    FunctionTree<D> b_tree(*mra);
+    FunctionTree<D> ab_tree(*mra);
+    build_grid(a_tree, a_func);
+    build_grid(b_tree, b_func);
+    build_grid(ab_tree, ab_func);
+    project(prec, a_tree, a_func);
+    project(prec, b_tree, b_func);
+    project(prec, ab_tree, ab_func);
+
+    WHEN("the expression 2*a*b + 0.5*a - a*b is computed in one build") {
+        std::vector<FunctionTreeVector<D>> terms(3);
+        terms[0].push_back(std::make_tuple(2.0, &a_tree));
+        terms[0].push_back(std::make_tuple(1.0, &b_tree));
+        terms[1].push_back(std::make_tuple(0.5, &a_tree));
+        terms[2].push_back(std::make_tuple(-1.0, &b_tree));
+        terms[2].push_back(std::make_tuple(1.0, &a_tree));
+
+        FunctionTree<D> c_tree(*mra);
+        sum_of_products(prec, c_tree, terms);
+
+        THEN("it equals the separately computed sum of products") {
+            FunctionTree<D> ref_tree(*mra);
+            build_grid(ref_tree, ab_tree);
+            build_grid(ref_tree, a_tree);
+            add(-1.0, ref_tree, 1.0, ab_tree, 0.5, a_tree);
+
+            double ref_int = ab_tree.integrate() + 0.5 * a_tree.integrate();
+            REQUIRE(c_tree.integrate() == Approx(ref_int).epsilon(1.0e-6));
+            REQUIRE(dot(c_tree, ref_tree) == Approx(ref_tree.getSquareNorm()).epsilon(1.0e-6));
+            REQUIRE(c_tree.getSquareNorm() == Approx(ref_tree.getSquareNorm()).epsilon(1.0e-6));
+        }
+        THEN("the input trees have no generated nodes left") {
+            REQUIRE(a_tree.getNGenNodes() == 0);
+            REQUIRE(b_tree.getNGenNodes() == 0);
+        }
+    }
+    finalize(&mra);
+}
+
 } // namespace multiplication
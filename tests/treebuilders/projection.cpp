@@ -27,8 +27,10 @@
 
 #include "factory_functions.h"
 
+#include "functions/GaussExp.h"
 #include "treebuilders/grid.h"
 #include "treebuilders/multiply.h"
+#include "treebuilders/TreeBuilder.h"
 #include "treebuilders/project.h"
 
 using namespace mrcpp;
@@ -38,6 +40,8 @@ namespace projection {
 template <int D> void testProjectFunction();
 template <int D> void testProjectNarrowPeriodicGaussian();
 template <int D> void testProjectWidePeriodicGaussian();
+template <int D> void testProjectWithTasks();
+template <int D> void testReproject();
 
 SCENARIO("Projecting Gaussian function", "[projection], [tree_builder], [trees]") {
     GIVEN("a Gaussian of unit charge in 1D") { testProjectFunction<1>(); }
@@ -51,6 +55,18 @@ SCENARIO("Projecting Gaussian function", "[projection], [tree_builder], [trees]"
     GIVEN("A periodic wide Gaussian of unit charge in 3D") { testProjectWidePeriodicGaussian<3>(); }
 }
 
+SCENARIO("Projecting with the task-based tree builder", "[projection_tasks], [projection], [tree_builder]") {
+    GIVEN("a Gaussian of unit charge in 1D") { testProjectWithTasks<1>(); }
+    GIVEN("a Gaussian of unit charge in 2D") { testProjectWithTasks<2>(); }
+    GIVEN("a Gaussian of unit charge in 3D") { testProjectWithTasks<3>(); }
+}
+
+SCENARIO("Re-projecting a function in a region", "[reprojection], [projection], [tree_builder]") {
+    GIVEN("two Gaussians in 1D") { testReproject<1>(); }
+    GIVEN("two Gaussians in 2D") { testReproject<2>(); }
+    GIVEN("two Gaussians in 3D") { testReproject<3>(); }
+}
+
 template <int D> void testProjectFunction() {
     GaussFunc<D> *func = nullptr;
     initialize(&func);
@@ -144,4 +160,117 @@ template <int D> void testProjectWidePeriodicGaussian() {
     REQUIRE(f_tree.integrate() == Approx(1.0));
 }
 
+template <int D> void testProjectWithTasks() {
+    const double prec = 1.0e-4;
+    GaussFunc<D> *func = nullptr;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = nullptr;
+    initialize(&mra);
+
+    FunctionTree<D> ref_tree(*mra);
+    project(prec, ref_tree, *func, -1, true);
+
+    WHEN("the function is projected with absolute precision") {
+        FunctionTree<D> tree(*mra);
+        set_build_engine(BuildEngine::Tasks);
+        project(prec, tree, *func, -1, true);
+        set_build_engine(BuildEngine::Levels);
+        THEN("the grid is the same as with the level-synchronous builder") {
+            REQUIRE(tree.getNNodes() == ref_tree.getNNodes());
+            REQUIRE(tree.getNEndNodes() == ref_tree.getNEndNodes());
+        }
+        THEN("the function is the same") {
+            const double norm = ref_tree.getSquareNorm();
+            REQUIRE(tree.getSquareNorm() == Approx(norm));
+            REQUIRE(dot(tree, ref_tree) == Approx(norm));
+        }
+    }
+    WHEN("the function is projected with relative precision") {
+        FunctionTree<D> tree(*mra);
+        FunctionTree<D> lev_tree(*mra);
+        project(prec, lev_tree, *func);
+        set_build_engine(BuildEngine::Tasks);
+        project(prec, tree, *func);
+        set_build_engine(BuildEngine::Levels);
+        THEN("the grid is at least as refined as with the level-synchronous builder") {
+            REQUIRE(tree.getNNodes() >= lev_tree.getNNodes());
+        }
+        THEN("it integrates to approximately one") { REQUIRE(tree.integrate() == Approx(1.0).epsilon(1.0e-8)); }
+    }
+    WHEN("the refinement is limited by maxIter") {
+        FunctionTree<D> tree(*mra);
+        FunctionTree<D> lev_tree(*mra);
+        project(prec, lev_tree, *func, 2, true);
+        set_build_engine(BuildEngine::Tasks);
+        project(prec, tree, *func, 2, true);
+        set_build_engine(BuildEngine::Levels);
+        THEN("the grid is the same as with the level-synchronous builder") {
+            REQUIRE(tree.getNNodes() == lev_tree.getNNodes());
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+template <int D> void testReproject() {
+    const double prec = 1.0e-4;
+    GaussFunc<D> *func = nullptr;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = nullptr;
+    initialize(&mra);
+
+    // a second Gaussian that is moved within the region [lb, ub]
+    double old_c[3] = {-0.40, 0.80, 1.60};
+    double new_c[3] = {-0.38, 0.78, 1.58};
+    double lb_c[3] = {-0.45, 0.73, 1.53};
+    double ub_c[3] = {-0.33, 0.85, 1.65};
+    auto old_pos = details::convert_to_std_array<double, D>(old_c);
+    auto new_pos = details::convert_to_std_array<double, D>(new_c);
+    auto lb = details::convert_to_std_array<double, D>(lb_c);
+    auto ub = details::convert_to_std_array<double, D>(ub_c);
+
+    GaussExp<D> old_func;
+    old_func.append(*func);
+    old_func.append(GaussFunc<D>(func->getExp()[0], func->getCoef(), old_pos));
+    GaussExp<D> new_func;
+    new_func.append(*func);
+    new_func.append(GaussFunc<D>(func->getExp()[0], func->getCoef(), new_pos));
+
+    FunctionTree<D> tree(*mra);
+    project(prec, tree, old_func, -1, true);
+    const Coord<D> r = func->getPos();
+    const double ref_val = tree.evalf(r);
+
+    WHEN("the moved Gaussian is re-projected in its region") {
+        reproject<D>(prec, tree, new_func, lb, ub, -1, true);
+
+        THEN("it equals a full projection of the new function") {
+            FunctionTree<D> ref_tree(*mra);
+            project(prec, ref_tree, new_func, -1, true);
+            const double norm = ref_tree.getSquareNorm();
+            REQUIRE(tree.integrate() == Approx(ref_tree.integrate()).epsilon(1.0e-8));
+            REQUIRE(tree.getSquareNorm() == Approx(norm).epsilon(1.0e-8));
+            REQUIRE(dot(tree, ref_tree) == Approx(norm).epsilon(1.0e-8));
+        }
+        THEN("the function outside the region is unchanged") { REQUIRE(tree.evalf(r) == ref_val); }
+    }
+    WHEN("the moved Gaussian is re-projected with relative precision") {
+        FunctionTree<D> rel_tree(*mra);
+        project(prec, rel_tree, old_func);
+        reproject<D>(prec, rel_tree, new_func, lb, ub);
+
+        THEN("it equals a full projection of the new function") {
+            FunctionTree<D> ref_tree(*mra);
+            project(prec, ref_tree, new_func);
+            const double norm = ref_tree.getSquareNorm();
+            REQUIRE(rel_tree.getNEndNodes() >= ref_tree.getNEndNodes());
+            REQUIRE(rel_tree.integrate() == Approx(ref_tree.integrate()).epsilon(1.0e-8));
+            REQUIRE(rel_tree.getSquareNorm() == Approx(norm).epsilon(1.0e-8));
+            REQUIRE(dot(rel_tree, ref_tree) == Approx(norm).epsilon(1.0e-8));
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
 } // namespace projection
@@ -27,7 +27,13 @@
 
 #include "factory_functions.h"
 
+#include "treebuilders/grid.h"
 #include "treebuilders/multiply.h"
+#include "treebuilders/project.h"
+#include "trees/ChunkPool.h"
+#include "trees/MWNode.h"
+#include "trees/SerialFunctionTree.h"
+#include "utils/numa_utils.h"
 
 using namespace mrcpp;
 
@@ -96,7 +102,221 @@ template <int D> void testGeneratedNodes() {
             }
         }
     }
+    WHEN("non-existing nodes are fetched by several threads") {
+        int nNodes = 0;
+#pragma omp parallel for schedule(static) reduction(+ : nNodes)
+        for (int i = 0; i < 16; i++) {
+            Coord<D> r_i = r;
+            r_i[0] += 0.01 * i;
+            MWNode<D> &node = tree.getNode(r_i, depth + i % 3);
+            if (node.getDepth() == depth + i % 3) nNodes++;
+        }
+        THEN("all nodes are generated") {
+            REQUIRE(nNodes == 16);
+            REQUIRE(tree.getNGenNodes() > 0);
+
+            AND_WHEN("the GenNodes are deleted") {
+                tree.deleteGenerated();
+                THEN("there will be no GenNodes") { REQUIRE(tree.getNGenNodes() == 0); }
+            }
+        }
+    }
+    finalize(&mra);
+}
+
+SCENARIO("FunctionTree coefficient placement", "[function_tree_placement], [function_tree], [trees]") {
+    const double prec = 1.0e-4;
+
+    GaussFunc<3> *func = nullptr;
+    initialize(&func);
+    MultiResolutionAnalysis<3> *mra = nullptr;
+    initialize(&mra);
+
+    FunctionTree<3> f_tree(*mra);
+    project(prec, f_tree, *func);
+
+    WHEN("the coefficients are allocated on huge pages") {
+        FunctionTree<3> g_tree(*mra);
+        g_tree.getSerialFunctionTree()->setHugePages(true);
+        project(prec, g_tree, *func);
+        THEN("the function is unchanged") {
+            REQUIRE(g_tree.getNNodes() == f_tree.getNNodes());
+            REQUIRE(g_tree.integrate() == Approx(f_tree.integrate()).epsilon(1.0e-12));
+            REQUIRE(g_tree.getSquareNorm() == Approx(f_tree.getSquareNorm()).epsilon(1.0e-12));
+        }
+    }
+    WHEN("the page placement is queried") {
+        SerialFunctionTree<3> &sTree = *f_tree.getSerialFunctionTree();
+        std::map<int, int> pages = sTree.getNumaPageCount();
+        THEN("all coefficient pages are accounted for, if available") {
+            int nPages = 0;
+            for (auto &p : pages) nPages += p.second;
+            if (not pages.empty()) {
+                const int pageSize = numa_utils::get_page_size();
+                const int chunkSize = sTree.sizeNodeCoeff * sTree.maxNodesPerChunk * sizeof(double);
+                REQUIRE(nPages >= sTree.getNChunks() * (chunkSize / pageSize));
+            }
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+SCENARIO("Virtual FunctionTree nodes", "[function_tree_virtual], [function_tree], [trees]") {
+    const double prec = 1.0e-4;
+
+    GaussFunc<3> *func = nullptr;
+    initialize(&func);
+    MultiResolutionAnalysis<3> *mra = nullptr;
+    initialize(&mra);
+
+    FunctionTree<3> f_tree(*mra);
+    project(prec, f_tree, *func);
+
+    // a node two levels below the EndNode at r
+    Coord<3> r = {-0.2, 0.5, 1.0};
+    const MWNode<3> &end_node = f_tree.getNodeOrEndNode(r);
+    NodeIndex<3> idx(NodeIndex<3>(end_node.getNodeIndex(), 5), 2);
+
+    const int n_coefs = f_tree.getTDim() * f_tree.getKp1_d();
+    std::vector<double> coefs(n_coefs);
+    std::vector<double> vals(n_coefs);
+
+    WHEN("the coefs of a non-existing node are computed") {
+        f_tree.getNodeCoefs(idx, coefs.data());
+        f_tree.getNodeValues(idx, vals.data());
+
+        THEN("no GenNodes are allocated") { REQUIRE(f_tree.getNGenNodes() == 0); }
+        THEN("they equal the coefs of the generated node") {
+            MWNode<3> &gen_node = f_tree.getNode(idx);
+            REQUIRE(gen_node.isGenNode());
+            for (int i = 0; i < gen_node.getNCoefs(); i++) {
+                REQUIRE(coefs[i] == Approx(gen_node.getCoefs()[i]).margin(1.0e-14));
+            }
+            for (int i = gen_node.getNCoefs(); i < n_coefs; i++) { REQUIRE(coefs[i] == 0.0); }
+
+            MWNode<3> gen_copy(gen_node);
+            gen_copy.mwTransform(Reconstruction);
+            gen_copy.cvTransform(Forward);
+            for (int i = 0; i < n_coefs; i++) { REQUIRE(vals[i] == Approx(gen_copy.getCoefs()[i]).margin(1.0e-12)); }
+            f_tree.deleteGenerated();
+        }
+    }
+    WHEN("the values of an existing node are computed") {
+        f_tree.getNodeValues(end_node.getNodeIndex(), vals.data());
+
+        THEN("they are the function values in the quadrature points of the children") {
+            MWNode<3> ref_copy(end_node);
+            ref_copy.mwTransform(Reconstruction);
+            ref_copy.cvTransform(Forward);
+            for (int i = 0; i < n_coefs; i++) { REQUIRE(vals[i] == Approx(ref_copy.getCoefs()[i]).margin(1.0e-12)); }
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+SCENARIO("Repacking FunctionTree memory", "[function_tree_repack], [function_tree], [trees]") {
+    const double prec = 1.0e-4;
+
+    GaussFunc<3> *func = nullptr;
+    initialize(&func);
+    MultiResolutionAnalysis<3> *mra = nullptr;
+    initialize(&mra);
+
+    FunctionTree<3> f_tree(*mra);
+    project(prec / 100, f_tree, *func);
+    f_tree.crop(prec);
+
+    Coord<3> r = {0.1, -0.2, 0.05};
+    const double ref_val = f_tree.evalf(r);
+    const double ref_charge = f_tree.integrate();
+    const double ref_norm = f_tree.getSquareNorm();
+    const int ref_nodes = f_tree.getNNodes();
+    const int ref_chunks = f_tree.getNChunks();
+
+    WHEN("a cropped function is repacked") {
+        f_tree.repack();
+        THEN("the function is unchanged") {
+            REQUIRE(f_tree.getNNodes() == ref_nodes);
+            REQUIRE(f_tree.evalf(r) == Approx(ref_val).epsilon(1.0e-12));
+            REQUIRE(f_tree.integrate() == Approx(ref_charge).epsilon(1.0e-12));
+            REQUIRE(f_tree.getSquareNorm() == Approx(ref_norm).epsilon(1.0e-12));
+        }
+        THEN("no unused chunks remain") {
+            REQUIRE(f_tree.getNChunks() <= ref_chunks);
+            REQUIRE(f_tree.getNChunks() == f_tree.getNChunksUsed());
+        }
+        AND_WHEN("the repacked function is refined") {
+            refine_grid(f_tree, 1);
+            THEN("the function is unchanged") {
+                REQUIRE(f_tree.getNNodes() > ref_nodes);
+                REQUIRE(f_tree.integrate() == Approx(ref_charge).epsilon(1.0e-12));
+                REQUIRE(f_tree.getSquareNorm() == Approx(ref_norm).epsilon(1.0e-12));
+            }
+        }
+    }
+    WHEN("a grid without coefficients is repacked") {
+        FunctionTree<3> g_tree(*mra);
+        build_grid(g_tree, *func);
+        const int grid_nodes = g_tree.getNNodes();
+        REQUIRE(g_tree.getSquareNorm() == -1.0);
+        g_tree.repack();
+        THEN("the grid is unchanged and the norm still undefined") {
+            REQUIRE(g_tree.getNNodes() == grid_nodes);
+            REQUIRE(g_tree.getSquareNorm() == -1.0);
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+SCENARIO("Recycling FunctionTree chunks", "[function_tree_chunk_pool], [function_tree], [trees]") {
+    const double prec = 1.0e-4;
+
+    GaussFunc<3> *func = nullptr;
+    initialize(&func);
+    MultiResolutionAnalysis<3> *mra = nullptr;
+    initialize(&mra);
+    const int kp1 = mra->getOrder() + 1;
+
+    FunctionTree<3> f_tree(*mra);
+    project(prec, f_tree, *func);
+
+    ChunkPool::setEnabled(true);
+    WHEN("a tree is deleted") {
+        int nChunks = 0;
+        {
+            FunctionTree<3> g_tree(*mra);
+            project(prec, g_tree, *func);
+            nChunks = g_tree.getNChunks();
+        }
+        THEN("its chunks are kept in the pool") {
+            REQUIRE(ChunkPool::getNCached() == nChunks);
+            REQUIRE(ChunkPool::getNCached(3, kp1 * kp1 * kp1) == nChunks);
+        }
+        AND_WHEN("a new tree is built") {
+            FunctionTree<3> h_tree(*mra);
+            project(prec, h_tree, *func);
+            THEN("it is built from the recycled chunks") {
+                REQUIRE(ChunkPool::getNCached() == nChunks - h_tree.getNChunks());
+                REQUIRE(h_tree.getNNodes() == f_tree.getNNodes());
+                REQUIRE(h_tree.getSquareNorm() == Approx(f_tree.getSquareNorm()).epsilon(1.0e-12));
+            }
+        }
+        AND_WHEN("the high-water mark is lowered") {
+            ChunkPool::setHighWaterMark(1);
+            THEN("the pool is trimmed") { REQUIRE(ChunkPool::getNCached() == 1); }
+        }
+        AND_WHEN("the pool is disabled") {
+            ChunkPool::setEnabled(false);
+            THEN("the pool is emptied") { REQUIRE(ChunkPool::getNCached() == 0); }
+        }
+    }
+    ChunkPool::setEnabled(false);
+    ChunkPool::setHighWaterMark(64);
     finalize(&mra);
+    finalize(&func);
 }
 
 } // namespace function_tree
@@ -26,6 +26,9 @@
 #include "catch.hpp"
 
 #include "factory_functions.h"
+
+#include "treebuilders/grid.h"
+#include "treebuilders/project.h"
 #include "trees/MWNode.h"
 
 using namespace mrcpp;
@@ -33,6 +36,8 @@ using namespace mrcpp;
 namespace mw_tree {
 
 template <int D> void testNodeFetchers();
+template <int D> void testNodeHashTable();
+template <int D> void testNearbyNodes();
 
 TEST_CASE("MWTree: Fetching nodes", "[mw_tree_fetch], [mw_tree], [trees]") {
     SECTION("1D") { testNodeFetchers<1>(); }
@@ -186,4 +191,122 @@ template <int D> void testNodeFetchers() {
     finalize(&mra);
 }
 
+TEST_CASE("MWTree: Fetching nodes through hash table", "[mw_tree_hash], [mw_tree], [trees]") {
+    SECTION("1D") { testNodeHashTable<1>(); }
+    SECTION("2D") { testNodeHashTable<2>(); }
+    SECTION("3D") { testNodeHashTable<3>(); }
+}
+
+template <int D> void testNodeHashTable() {
+    MultiResolutionAnalysis<D> *mra = nullptr;
+    initialize(&mra);
+
+    GaussFunc<D> *func = nullptr;
+    initialize(&func);
+
+    FunctionTree<D> tree(*mra);
+    project(1.0e-3, tree, *func);
+
+    // Reference lookups, descending from the root
+    MWNodeVector<D> nodeTable;
+    tree.makeNodeTable(nodeTable);
+    std::vector<NodeIndex<D>> indices;
+    for (auto *node : nodeTable) {
+        indices.push_back(node->getNodeIndex());
+        for (int i = 0; i < node->getTDim(); i++) indices.push_back(NodeIndex<D>(node->getNodeIndex(), i));
+    }
+    std::vector<MWNode<D> *> ref_find;
+    std::vector<MWNode<D> *> ref_end;
+    for (auto &idx : indices) {
+        ref_find.push_back(tree.findNode(idx));
+        ref_end.push_back(&tree.getNodeOrEndNode(idx));
+    }
+
+    tree.makeNodeHashTable();
+    REQUIRE(tree.hasNodeHashTable());
+
+    SECTION("Lookups agree with the tree traversal") {
+        for (int i = 0; i < indices.size(); i++) {
+            REQUIRE(tree.findNode(indices[i]) == ref_find[i]);
+            REQUIRE(&tree.getNodeOrEndNode(indices[i]) == ref_end[i]);
+        }
+    }
+    SECTION("Generated nodes are not added to the table") {
+        MWNode<D> &end = tree.getEndMWNode(0);
+        NodeIndex<D> idx(NodeIndex<D>(end.getNodeIndex(), 0), 0);
+        MWNode<D> &node = tree.getNode(idx);
+        REQUIRE(node.getNodeIndex() == idx);
+        REQUIRE(node.isGenNode());
+        REQUIRE(tree.findNode(idx) == nullptr);
+        tree.deleteGenerated();
+    }
+    SECTION("The table follows refinement and clearing of the tree") {
+        refine_grid(tree, 1);
+        for (int i = 0; i < tree.getNEndNodes(); i++) {
+            MWNode<D> &node = tree.getEndMWNode(i);
+            REQUIRE(tree.findNode(node.getNodeIndex()) == &node);
+        }
+        tree.clear();
+        for (auto &idx : indices) {
+            MWNode<D> *node = tree.findNode(idx);
+            REQUIRE((node == nullptr or node->isRootNode()));
+        }
+    }
+    SECTION("Grid building looks up input nodes in the table") {
+        FunctionTree<D> ref(*mra);
+        FunctionTree<D> out(*mra);
+        tree.deleteNodeHashTable();
+        build_grid(ref, tree);
+        REQUIRE_FALSE(tree.hasNodeHashTable()); // temporary table is removed
+        tree.makeNodeHashTable();
+        build_grid(out, tree);
+        REQUIRE(tree.hasNodeHashTable()); // the caller's table is kept
+        REQUIRE(out.getNNodes() == ref.getNNodes());
+        REQUIRE(out.getNNodes() == tree.getNNodes());
+        REQUIRE(refine_grid(out, tree) == 0);
+    }
+    tree.deleteNodeHashTable();
+    REQUIRE_FALSE(tree.hasNodeHashTable());
+
+    finalize(&func);
+    finalize(&mra);
+}
+
+TEST_CASE("MWTree: Fetching nodes from a nearby node", "[mw_tree_nearby], [mw_tree], [trees]") {
+    SECTION("1D") { testNearbyNodes<1>(); }
+    SECTION("2D") { testNearbyNodes<2>(); }
+    SECTION("3D") { testNearbyNodes<3>(); }
+}
+
+template <int D> void testNearbyNodes() {
+    MultiResolutionAnalysis<D> *mra = nullptr;
+    initialize(&mra);
+
+    GaussFunc<D> *func = nullptr;
+    initialize(&func);
+
+    FunctionTree<D> tree(*mra);
+    project(1.0e-3, tree, *func);
+
+    // Neighbours of the children of each EndNode, within and across root boxes
+    for (int n = 0; n < tree.getNEndNodes(); n++) {
+        MWNode<D> &near = tree.getEndMWNode(n);
+        NodeIndex<D> idx(near.getNodeIndex(), 0);
+        for (int d = 0; d < D; d++) {
+            for (int dl : {-3, -1, 1, 2}) {
+                NodeIndex<D> nIdx(idx);
+                nIdx.getTranslation()[d] += dl;
+                if (tree.getRootIndex(nIdx) < 0) continue;
+                MWNode<D> &node = tree.getNode(nIdx, near);
+                REQUIRE(node.getNodeIndex() == nIdx);
+                REQUIRE(&node == &tree.getNode(nIdx));
+            }
+        }
+    }
+    tree.deleteGenerated();
+
+    finalize(&func);
+    finalize(&mra);
+}
+
 } // namespace mw_tree
@@ -23,12 +23,16 @@
  * <https://mrcpp.readthedocs.io/>
  */
 
+#include <fstream>
+
 #include "catch.hpp"
 
 #include "factory_functions.h"
 
 #include "treebuilders/grid.h"
+#include "treebuilders/multiply.h"
 #include "treebuilders/project.h"
+#include "trees/MWNode.h"
 #include "trees/SerialFunctionTree.h"
 
 using namespace mrcpp;
@@ -59,6 +63,15 @@ SCENARIO("FunctionTree IO", "[tree_io], [trees]") {
             REQUIRE(f_tree.getSquareNorm() == Approx(ref_norm).epsilon(1.0e-12));
             REQUIRE(f_tree.getNNodes() == ref_nodes);
         }
+        THEN("the file starts with a versioned header") {
+            std::ifstream f("f.tree", std::ios::binary);
+            char magic[4];
+            int version;
+            f.read(magic, 4);
+            f.read((char *)&version, sizeof(int));
+            REQUIRE(std::string(magic, 4) == "MRFT");
+            REQUIRE(version == 1);
+        }
         AND_WHEN("the saved function is load into a new tree") {
             FunctionTree<3> g_tree(*mra);
             g_tree.loadTree("f");
@@ -95,6 +108,77 @@ SCENARIO("FunctionTree IO", "[tree_io], [trees]") {
             }
         }
     }
+    WHEN("a cropped function is saved") {
+        f_tree.crop(10 * prec); // moves nodes around in the memory chunks
+        const double crop_charge = f_tree.integrate();
+        const double crop_norm = f_tree.getSquareNorm();
+        const int crop_nodes = f_tree.getNNodes();
+        const int crop_end_nodes = f_tree.getNEndNodes();
+        f_tree.saveTree("f");
+
+        AND_WHEN("the saved function is load into a new tree") {
+            FunctionTree<3> g_tree(*mra);
+            g_tree.loadTree("f");
+            THEN("the new tree is identical to the cropped one") {
+                REQUIRE(g_tree.integrate() == Approx(crop_charge).epsilon(1.0e-12));
+                REQUIRE(g_tree.getSquareNorm() == Approx(crop_norm).epsilon(1.0e-12));
+                REQUIRE(g_tree.getNNodes() == crop_nodes);
+                REQUIRE(g_tree.getNEndNodes() == crop_end_nodes);
+                REQUIRE(dot(g_tree, f_tree) == Approx(crop_norm).epsilon(1.0e-12));
+            }
+        }
+    }
+    WHEN("a grid without coefficients is saved") {
+        FunctionTree<3> grid(*mra);
+        build_grid(grid, f_tree);
+        const int grid_nodes = grid.getNNodes();
+        grid.saveTree("f");
+
+        AND_WHEN("the saved grid is load into a new tree") {
+            FunctionTree<3> g_tree(*mra);
+            g_tree.loadTree("f");
+            THEN("the new tree has the same grid and an undefined norm") {
+                REQUIRE(g_tree.getNNodes() == grid_nodes);
+                REQUIRE(g_tree.getSquareNorm() == -1.0);
+            }
+        }
+    }
+    WHEN("a function is stored in single precision") {
+        f_tree.setSinglePrecision(true);
+        THEN("the norms and structure are unchanged") {
+            REQUIRE(f_tree.isSinglePrecision());
+            REQUIRE(f_tree.getSquareNorm() == Approx(ref_norm).epsilon(1.0e-12));
+            REQUIRE(f_tree.getNNodes() == ref_nodes);
+        }
+        THEN("the nodes report no double precision coefficients") {
+            for (int i = 0; i < f_tree.getNEndNodes(); i++) {
+                REQUIRE(not f_tree.getEndMWNode(i).hasCoefs());
+                REQUIRE(f_tree.getEndMWNode(i).getCoefs() == nullptr);
+            }
+            REQUIRE(not f_tree.getRootMWNode(0).hasCoefs());
+        }
+        AND_WHEN("the function is converted back to double precision") {
+            f_tree.setSinglePrecision(false);
+            THEN("the function is accurate to single precision") {
+                REQUIRE(not f_tree.isSinglePrecision());
+                for (int i = 0; i < f_tree.getNEndNodes(); i++) REQUIRE(f_tree.getEndMWNode(i).hasCoefs());
+                REQUIRE(f_tree.integrate() == Approx(ref_charge).epsilon(1.0e-6));
+                REQUIRE(dot(f_tree, f_tree) == Approx(ref_norm).epsilon(1.0e-6));
+            }
+        }
+        AND_WHEN("the function is saved and load into a new tree") {
+            f_tree.saveTree("f");
+            FunctionTree<3> g_tree(*mra);
+            g_tree.loadTree("f");
+            THEN("the new tree is in double precision, accurate to single precision") {
+                REQUIRE(not g_tree.isSinglePrecision());
+                REQUIRE(g_tree.getNNodes() == ref_nodes);
+                REQUIRE(g_tree.getSquareNorm() == Approx(ref_norm).epsilon(1.0e-12));
+                REQUIRE(g_tree.integrate() == Approx(ref_charge).epsilon(1.0e-6));
+                REQUIRE(dot(g_tree, g_tree) == Approx(ref_norm).epsilon(1.0e-6));
+            }
+        }
+    }
     // Delete saved file
     remove("f.tree");
 